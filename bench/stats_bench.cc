@@ -0,0 +1,240 @@
+/*
+ * Microbenchmarks for the stats callbacks. Drives CacheStats and FlashStats
+ * (and the wide-key/sweep/null variants, for comparison) with a synthetic Zipfian
+ * request stream and reports, per callback: ns per call, heap allocations
+ * per call, and peak RSS after each key-space size.
+ *
+ * Build from the repository root:
+ *   g++ -O2 -std=c++17 -I. bench/stats_bench.cc common.cc -o stats_bench
+ *
+ * Usage: stats_bench [events] [key_space ...]
+ *   defaults: 2000000 events over key spaces of 1e3, 1e5 and 1e6 keys
+ */
+#include "cache_stats.h"
+#include "flash_stats.h"
+#include "null_stats.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <sys/resource.h>
+
+// Count every heap allocation made through operator new. GCC cannot see
+// that the replacement new and delete below pair up, hence the pragma.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+static size_t alloc_count = 0;
+static size_t alloc_bytes = 0;
+
+void *operator new(size_t size) {
+	alloc_count++;
+	alloc_bytes += size;
+	void *p = std::malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+
+// Zipf(theta) over [0, n), sampled by inverting a precomputed CDF
+class ZipfGenerator {
+public:
+	std::vector<double> cdf;
+	std::mt19937_64 rng;
+	std::uniform_real_distribution<double> uniform;
+
+	ZipfGenerator(size_t n, double theta, uint64_t seed)
+		: cdf(n), rng(seed), uniform(0.0, 1.0) {
+		double sum = 0;
+		for (size_t i = 0; i < n; ++i) {
+			sum += 1.0 / std::pow((double)(i + 1), theta);
+			cdf[i] = sum;
+		}
+		for (auto &c : cdf) {
+			c /= sum;
+		}
+	}
+
+	size_t next() {
+		auto it = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng));
+		return std::min((size_t)(it - cdf.begin()), cdf.size() - 1);
+	}
+};
+
+struct Event {
+	okey_t key;
+	osize_t size;
+	bool hit;
+	bool admitted;
+};
+
+// Hits are "seen before and not in the 1-in-8 cold slice of the key space";
+// enough to give every callback a realistic mix of arguments.
+std::vector<Event> make_events(size_t n, size_t key_space) {
+	ZipfGenerator zipf(key_space, 0.99, 42);
+	std::vector<bool> seen(key_space, false);
+	std::vector<Event> events(n);
+	for (auto &e : events) {
+		size_t rank = zipf.next();
+		// Scatter popular ranks over the key space
+		e.key = (okey_t)((rank * 2654435761u) % key_space);
+		e.size = 100 + (e.key % 64) * 64;
+		e.hit = seen[e.key] && (e.key % 8 != 0);
+		e.admitted = (e.key % 4 != 0);
+		seen[e.key] = true;
+	}
+	return events;
+}
+
+struct Result {
+	double ns_per_call;
+	double allocs_per_call;
+	double bytes_per_call;
+};
+
+template <typename F>
+Result time_calls(size_t calls, F fn) {
+	size_t allocs = alloc_count;
+	size_t bytes = alloc_bytes;
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	return {ns / calls, (double)(alloc_count - allocs) / calls,
+		(double)(alloc_bytes - bytes) / calls};
+}
+
+void report(std::string stats, size_t key_space, std::string callback, Result r) {
+	std::printf("%-12s %9zu  %-24s %10.2f ns  %8.3f allocs  %10.1f B\n",
+			stats.c_str(), key_space, callback.c_str(), r.ns_per_call,
+			r.allocs_per_call, r.bytes_per_call);
+}
+
+const int SEGMENT_PERIOD = 100000;
+
+template <typename Stats>
+void bench_cache_stats(std::string name, std::vector<Event> const &events,
+		size_t key_space) {
+	Stats stats(SEGMENT_PERIOD);
+	size_t n = events.size();
+
+	report(name, key_space, "on_access", time_calls(n, [&] {
+		for (auto &e : events) stats.on_access(e.size);
+	}));
+	report(name, key_space, "on_hit", time_calls(n, [&] {
+		for (auto &e : events) stats.on_hit(e.size);
+	}));
+	report(name, key_space, "on_miss", time_calls(n, [&] {
+		for (auto &e : events) stats.on_miss(e.size);
+	}));
+	report(name, key_space, "on_insert_attempt", time_calls(n, [&] {
+		for (auto &e : events) stats.on_insert_attempt(e.size, e.admitted);
+	}));
+
+	size_t segments = n / SEGMENT_PERIOD + 1;
+	report(name, key_space, "collect_periodic_stats", time_calls(segments, [&] {
+		for (size_t i = 0; i < segments; ++i) stats.collect_periodic_stats();
+	}));
+	report(name, key_space, "dump_counters_as_json", time_calls(1, [&] {
+		volatile size_t len = stats.dump_counters_as_json().size();
+		(void)len;
+	}));
+}
+
+template <typename Stats>
+void bench_flash_stats(std::string name, std::vector<Event> const &events,
+		size_t key_space) {
+	Stats stats(SEGMENT_PERIOD, true);
+	size_t n = events.size();
+
+	report(name, key_space, "on_access", time_calls(n, [&] {
+		for (auto &e : events) stats.on_access(e.size);
+	}));
+	report(name, key_space, "on_hit", time_calls(n, [&] {
+		for (auto &e : events) stats.on_hit(e.key, e.size);
+	}));
+	report(name, key_space, "on_miss", time_calls(n, [&] {
+		for (auto &e : events) stats.on_miss(e.key, e.size);
+	}));
+	report(name, key_space, "on_insert_attempt", time_calls(n, [&] {
+		for (auto &e : events) stats.on_insert_attempt(e.key, e.size, e.admitted);
+	}));
+	report(name, key_space, "on_copyfwd_attempt", time_calls(n, [&] {
+		for (auto &e : events) stats.on_copyfwd_attempt(e.key, e.size, e.admitted);
+	}));
+	report(name, key_space, "on_erase", time_calls(n, [&] {
+		for (auto &e : events) stats.on_erase(e.key, e.size);
+	}));
+
+	// One whole request: lookup, hit or miss + admission + write
+	report(name, key_space, "request_path", time_calls(n, [&] {
+		for (auto &e : events) {
+			stats.on_access(e.size);
+			if (e.hit) {
+				stats.on_hit(e.key, e.size);
+			} else {
+				stats.on_miss(e.key, e.size);
+				stats.on_insert_attempt(e.key, e.size, e.admitted);
+				if (e.admitted) {
+					stats.on_write(e.size);
+				}
+			}
+		}
+	}));
+
+	size_t segments = n / SEGMENT_PERIOD + 1;
+	report(name, key_space, "collect_periodic_stats", time_calls(segments, [&] {
+		for (size_t i = 0; i < segments; ++i) stats.collect_periodic_stats(0);
+	}));
+	report(name, key_space, "dump_counters_as_json", time_calls(1, [&] {
+		volatile size_t len = stats.dump_counters_as_json().size();
+		(void)len;
+	}));
+}
+
+long peak_rss_kb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+int main(int argc, char **argv) {
+	size_t num_events = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+	std::vector<size_t> key_spaces;
+	for (int i = 2; i < argc; ++i) {
+		key_spaces.push_back(std::strtoull(argv[i], nullptr, 10));
+	}
+	if (key_spaces.empty()) {
+		key_spaces = {1000, 100000, 1000000};
+	}
+
+	for (auto key_space : key_spaces) {
+		auto events = make_events(num_events, key_space);
+
+		bench_cache_stats<CacheStats>("cache", events, key_space);
+		bench_cache_stats<CacheStatsT<SweepStatsFeatures>>("cache_sweep",
+				events, key_space);
+		bench_cache_stats<NullCacheStats>("cache_null", events, key_space);
+
+		bench_flash_stats<FlashStats>("flash", events, key_space);
+		bench_flash_stats<FlashStatsT<WideKeyStatsFeatures>>("flash_wide",
+				events, key_space);
+		bench_flash_stats<FlashStatsT<SweepStatsFeatures>>("flash_sweep",
+				events, key_space);
+		bench_flash_stats<NullFlashStats>("flash_null", events, key_space);
+
+		std::printf("peak_rss_kb %ld after key space %zu\n", peak_rss_kb(),
+				key_space);
+	}
+	return 0;
+}
@@ -1,12 +1,31 @@
+#ifndef CACHE_STATS_H
+#define CACHE_STATS_H
+
 #include "common.h"
+#include "count_min.h"
+#include "counter_set.h"
+#include "event_log.h"
+#include "ewma.h"
+#include "partition_stats.h"
+#include "profiler.h"
+#include "shadow_lru.h"
+#include "stats_features.h"
+#include "tier_stats.h"
 
-class CacheStats {
+template <typename Features = DefaultStatsFeatures>
+class CacheStatsT {
 public: 
 	/*
 	* === Various types of misses; first is bytes, second is objects
 	* "total_misses": includes all miss types. 
-	* "compulsory_misses": first accesses
+	* "compulsory_misses": first accesses, including the first after a 
+		* delete or overwrite (on_invalidate)
 	* "capacity_misses": misses from objects that got evicted b/c they didn't fit
+	* "conflict_misses": misses that a fully associative LRU of the same 
+		* size would have hit (e.g. set conflicts, or a non-LRU policy)
+		* These three need keyed accesses and enable_shadow_lru(), and 
+		* on_invalidate()/on_admission_reject() for caches that drop keys 
+		* other than by eviction
 	* "one_hit_misses": misses on objects not read again
 	* "bad_choice_misses": misses on objects that we evicted but the caching 
 		* algorithm might have kept
@@ -24,27 +43,210 @@ public:
 	* === Bytes written
 	* "objects_written"
 	*/
-	std::unordered_map<std::string, Counter> counters; 
+	typedef typename Features::key_type key_type;
+	typedef typename Features::counter_type counter_type;
+
+	// Global counters, indexed by CounterId; names are only for the dump
+	enum CounterId {
+		C_TOTAL_READS,
+		C_TOTAL_MISSES,
+		C_TOTAL_HITS,
+		C_INSERTS,
+		C_SKIPPED_INSERTS,
+		C_DRAM_HITS,
+		C_DRAM_MISSES,
+		C_COMPULSORY_MISSES,
+		C_CAPACITY_MISSES,
+		C_CONFLICT_MISSES,
+		NUM_COUNTERS,
+	};
+	static constexpr std::array<const char *, NUM_COUNTERS> counter_names = {
+		"total_reads",
+		"total_misses",
+		"total_hits",
+		"inserts",
+		"skipped_inserts",
+		"dram_hits",
+		"dram_misses",
+		"compulsory_misses",
+		"capacity_misses",
+		"conflict_misses",
+	};
+	CounterSet<counter_type, NUM_COUNTERS> counters; 
+
+	// Per-tenant and per-size-class copies of the request counters; see
+	// enable_tenant_stats() and enable_size_class_stats()
+	enum PartitionCounter {
+		P_READS,
+		P_HITS,
+		P_MISSES,
+		P_INSERTS,
+		P_SKIPPED_INSERTS,
+	};
+	PartitionedCounters tenant_stats; 
+	PartitionedCounters size_class_stats; 
+	SizeClassMap size_classes; 
+
+	// Per-tier hits/misses for multi-level hierarchies; see enable_tier_stats()
+	TierStats tier_stats; 
+
+	// Fully associative LRU beside the real cache, for splitting misses into 
+	// compulsory, capacity and conflict; see enable_shadow_lru(). 
+	// on_keyed_access() classifies the access, and a following on_miss() 
+	// counts it. 
+	enum AccessClass : uint8_t {
+		A_UNKEYED,
+		A_FIRST,
+		A_SHADOW_HIT,
+		A_SHADOW_MISS,
+	};
+	ShadowLru<key_type> shadow; 
+	FlatMap<key_type, uint8_t> seen_keys; 
+	AccessClass last_access = A_UNKEYED; 
+
+	// Access frequency estimates, shared with admission policies; see 
+	// enable_frequency_sketch() and frequency()
+	CountMinSketch frequency_sketch; 
+
+	// Decayed hit ratios for online feedback; see enable_ewma()
+	DecayedRatio recent_objects; 
+	DecayedRatio recent_bytes; 
+
+	// Time spent in each callback, when the policy enables profiling
+	CallbackProfile profile; 
+
+	// Raw event trace; see attach_event_log()
+	EventLog *event_log = nullptr; 
 
 	int inst_stats_period; 
 
-	CacheStats(int m) 
-		: inst_stats_period(m) {
-		counters = {
-			{"total_reads", {}},
-			{"total_misses", {}}, 
-			{"total_hits", {}},
-			{"inserts", {}},
-			{"skipped_inserts", {}}, 
-			{"dram_hits", {}},
-			{"dram_misses", {}},
-		};
-	}
-
-	Counter last_reads; 
-	Counter last_hits; 
-	Counter last_inserts; 
+	CacheStatsT(int m) 
+		: counters(counter_names), inst_stats_period(m) {
+		counters.hide(C_COMPULSORY_MISSES);
+		counters.hide(C_CAPACITY_MISSES);
+		counters.hide(C_CONFLICT_MISSES);
+	}
+
+	// Keep every counter and segment series per tenant as well. Events then
+	// carry a tenant ID in [0, num_tenants); events with any other ID are 
+	// left out of the tenant split and counted as out of range. 
+	void enable_tenant_stats(size_t num_tenants) {
+		static_assert(Features::partitions, "partitions disabled by policy");
+		tenant_stats = PartitionedCounters(partition_counter_names(), 
+				num_tenants);
+	}
+
+	// Keep every counter and segment series per object size class as well, 
+	// with class boundaries as described in SizeClassMap. 
+	void enable_size_class_stats(std::vector<osize_t> boundaries) {
+		static_assert(Features::partitions, "partitions disabled by policy");
+		size_classes = SizeClassMap(boundaries);
+		size_class_stats = PartitionedCounters(partition_counter_names(), 
+				size_classes.num_classes);
+	}
+
+	// Track hits and misses per cache tier, in lookup order. DRAM hits and 
+	// misses are also recorded against tier TIER_DRAM. 
+	void enable_tier_stats(std::vector<std::string> tier_names = 
+			{"dram", "flash_log", "flash_sets", "backend"}) {
+		static_assert(Features::tiers, "tiers disabled by policy");
+		tier_stats = TierStats(tier_names);
+	}
+
+	// Run a shadow fully associative LRU of capacity_bytes (normally the real 
+	// cache's capacity) and classify each miss after on_keyed_access(). 
+	void enable_shadow_lru(size_t capacity_bytes) {
+		static_assert(Features::per_key_tracking, 
+				"per-key tracking disabled by policy");
+		shadow = ShadowLru<key_type>(capacity_bytes);
+		counters.show(C_COMPULSORY_MISSES); 
+		counters.show(C_CAPACITY_MISSES); 
+		counters.show(C_CONFLICT_MISSES); 
+	}
+
+	// Count keyed accesses in a Count-Min sketch with about `num_counters` 
+	// counters per row, halved every sample_size accesses (0: 10 * 
+	// num_counters). 
+	// Policies can then read frequency() instead of keeping their own. 
+	void enable_frequency_sketch(size_t num_counters, 
+			uint64_t sample_size = 0) {
+		static_assert(Features::per_key_tracking, 
+				"per-key tracking disabled by policy");
+		frequency_sketch = CountMinSketch(num_counters, sample_size);
+	}
+
+	// Estimated recent accesses to key (never an underestimate before aging; 
+	// saturates at 255). 0 if the sketch is not enabled. 
+	uint32_t frequency(key_type key) {
+		if constexpr (Features::per_key_tracking) {
+			if (frequency_sketch.enabled()) {
+				return frequency_sketch.estimate(key);
+			}
+		}
+		return 0;
+	}
+
+	// Keep exponentially decayed hit ratios, weighting each request by half 
+	// after another half_life_requests requests. current_ohr() and 
+	// current_bhr() then cost a division. 
+	void enable_ewma(double half_life_requests) {
+		recent_objects = DecayedRatio(half_life_requests);
+		recent_bytes = DecayedRatio(half_life_requests);
+	}
+
+	double current_ohr() const {
+		return recent_objects.value();
+	}
+
+	double current_bhr() const {
+		return recent_bytes.value();
+	}
+
+	void update_ewma(osize_t osize, bool hit) {
+		if (recent_objects.enabled()) {
+			recent_objects.step();
+			recent_bytes.step();
+			recent_objects.den += 1;
+			recent_bytes.den += osize;
+			if (hit) {
+				recent_objects.num += 1;
+				recent_bytes.num += osize;
+			}
+		}
+	}
+
+	// Record every callback in `log` as well. The log is not owned and may be
+	// shared with a FlashStats driven from the same thread. 
+	void attach_event_log(EventLog *log) {
+		static_assert(Features::event_log, "event log disabled by policy");
+		event_log = log;
+	}
+
+	void log_event(EventType type, osize_t osize, tenant_t tenant, 
+			uint64_t key = 0) {
+		if constexpr (Features::event_log) {
+			if (event_log) {
+				event_log->push({key, osize, type, SRC_CACHE, tenant});
+			}
+		}
+	}
+
+	// Counters shared by on_access() and on_keyed_access()
+	void record_access(osize_t osize, tenant_t tenant) {
+		counters[C_TOTAL_READS].increment(osize);
+		record_partitions(P_READS, tenant, osize);
+	}
+
+	static std::vector<std::string> partition_counter_names() {
+		return {"total_reads", "total_hits", "total_misses", "inserts", 
+				"skipped_inserts"};
+	}
+
+	counter_type last_reads; 
+	counter_type last_hits; 
+	counter_type last_inserts; 
 	size_t last_bytes_written = 0; 
+	counter_t last_miss_bytes[3] = {}; 
 	
 	// BMR 
 	std::vector<size_t> segment_bytes_hit; 
@@ -54,12 +256,19 @@ public:
 	std::vector<size_t> segment_objects_hit; 
 	std::vector<size_t> segment_objects_read; 
 
+	// Miss breakdown, bytes
+	std::vector<size_t> segment_compulsory_misses; 
+	std::vector<size_t> segment_capacity_misses; 
+	std::vector<size_t> segment_conflict_misses; 
+
 	void collect_periodic_stats() {
-		auto bytes_read = counters["total_reads"].byte_counter; 
-		auto objects_read = counters["total_reads"].object_counter; 
+		ProfileScope<Features::profiling> scope(profile, PROF_COLLECT_PERIODIC_STATS);
+		log_event(EV_SEGMENT, 0, 0);
+		auto bytes_read = counters[C_TOTAL_READS].byte_counter; 
+		auto objects_read = counters[C_TOTAL_READS].object_counter; 
 
-		auto bytes_hit = counters["total_hits"].byte_counter;
-		auto objects_hit = counters["total_hits"].object_counter;
+		auto bytes_hit = counters[C_TOTAL_HITS].byte_counter;
+		auto objects_hit = counters[C_TOTAL_HITS].object_counter;
 
 		segment_bytes_read.push_back(bytes_read - last_reads.byte_counter);
 		segment_bytes_hit.push_back(bytes_hit - last_hits.byte_counter);
@@ -67,61 +276,244 @@ public:
 		segment_objects_read.push_back(objects_read - last_reads.object_counter);
 		segment_objects_hit.push_back(objects_hit - last_hits.object_counter);
 
-		last_reads = counters["total_reads"];
-		last_hits = counters["total_hits"]; 
+		last_reads = counters[C_TOTAL_READS];
+		last_hits = counters[C_TOTAL_HITS]; 
+
+		if (tenant_stats.enabled()) {
+			tenant_stats.collect_periodic_stats();
+		}
+		if (size_class_stats.enabled()) {
+			size_class_stats.collect_periodic_stats();
+		}
+		if (tier_stats.enabled()) {
+			tier_stats.collect_periodic_stats();
+		}
+		if (shadow.enabled()) {
+			std::vector<size_t> *series[3] = {&segment_compulsory_misses, 
+				&segment_capacity_misses, &segment_conflict_misses};
+			CounterId ids[3] = {C_COMPULSORY_MISSES, C_CAPACITY_MISSES, 
+				C_CONFLICT_MISSES};
+			for (size_t i = 0; i < 3; ++i) {
+				counter_t bytes = counters[ids[i]].byte_counter;
+				series[i]->push_back(bytes - last_miss_bytes[i]);
+				last_miss_bytes[i] = bytes;
+			}
+		}
 	}
 
 	void print_periodic_stats() {
 		std::cout << "\tSegment BHR: " 
 			<< (double)segment_bytes_hit.back()/segment_bytes_read.back() 
 			<< ", overall " 
-			<< (double)counters["total_hits"].byte_counter/counters["total_reads"].byte_counter
+			<< (double)counters[C_TOTAL_HITS].byte_counter/counters[C_TOTAL_READS].byte_counter
 			<< "\n\tSegment OHR: " 
 			<< (double)segment_objects_hit.back()/segment_objects_read.back() 
 			<< ", overall " 
-			<< (double)counters["total_hits"].object_counter/counters["total_reads"].object_counter; 
+			<< (double)counters[C_TOTAL_HITS].object_counter/counters[C_TOTAL_READS].object_counter; 
 		std::cout << std::endl;
+		if (tier_stats.enabled()) {
+			tier_stats.print_periodic_stats();
+		}
 	}
 
-	void on_miss(osize_t osize) {
-		counters["total_misses"].increment(osize);
+	void record_partitions(PartitionCounter counter, tenant_t tenant, 
+			osize_t osize) {
+		if constexpr (Features::partitions) {
+			if (tenant_stats.enabled()) {
+				tenant_stats.increment(counter, tenant, osize);
+			}
+			if (size_class_stats.enabled()) {
+				size_class_stats.increment(counter, size_classes.lookup(osize), osize);
+			}
+		}
+	}
+
+	void on_miss(osize_t osize, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_MISS);
+		log_event(EV_MISS, osize, tenant);
+		counters[C_TOTAL_MISSES].increment(osize);
+		record_partitions(P_MISSES, tenant, osize);
+		update_ewma(osize, false);
+
+		if constexpr (Features::per_key_tracking) {
+			switch (last_access) {
+			case A_FIRST:
+				counters[C_COMPULSORY_MISSES].increment(osize);
+				break;
+			case A_SHADOW_HIT:
+				counters[C_CONFLICT_MISSES].increment(osize);
+				break;
+			case A_SHADOW_MISS:
+				counters[C_CAPACITY_MISSES].increment(osize);
+				break;
+			case A_UNKEYED:
+				break;
+			}
+			last_access = A_UNKEYED;
+		}
 	}
 
-	void on_insert_attempt(osize_t osize, bool was_inserted) {
+	void on_insert_attempt(osize_t osize, bool was_inserted, 
+			tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_INSERT_ATTEMPT);
+		log_event(was_inserted ? EV_INSERT : EV_SKIPPED_INSERT, osize, tenant);
 		if (was_inserted) {
-			counters["inserts"].increment(osize);
+			counters[C_INSERTS].increment(osize);
+			record_partitions(P_INSERTS, tenant, osize);
 		} else {
-			counters["skipped_inserts"].increment(osize);
+			counters[C_SKIPPED_INSERTS].increment(osize);
+			record_partitions(P_SKIPPED_INSERTS, tenant, osize);
 		}
 	}
 
-	void on_access(osize_t osize) {
-		counters["total_reads"].increment(osize);
+	// The real cache dropped key for a reason other than capacity: deleted 
+	// or overwritten. With enable_shadow_lru(), the shadow LRU drops it too, 
+	// and the next miss on the key counts as compulsory (a new value). 
+	void on_invalidate(key_type key) {
+		log_event(EV_INVALIDATE, 0, 0, key);
+		if constexpr (Features::per_key_tracking) {
+			if (shadow.enabled()) {
+				shadow.erase(key);
+				seen_keys.erase(key);
+			}
+		}
+	}
+
+	// The real cache keeps no copy of the key it just missed on (admission 
+	// rejected it at every level). With enable_shadow_lru(), the shadow LRU 
+	// drops it too, so later misses on it are not taken for conflict misses. 
+	void on_admission_reject(key_type key) {
+		log_event(EV_ADMISSION_REJECT, 0, 0, key);
+		if constexpr (Features::per_key_tracking) {
+			if (shadow.enabled()) {
+				shadow.erase(key);
+			}
+		}
+	}
+
+	void on_access(osize_t osize, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_ACCESS);
+		log_event(EV_ACCESS, osize, tenant);
+		record_access(osize, tenant);
+		if constexpr (Features::per_key_tracking) {
+			last_access = A_UNKEYED;
+		}
+	}
+
+	// As on_access(), for simulators that pass the key. With 
+	// enable_shadow_lru(), the access also goes through the shadow LRU, to 
+	// classify a miss; with enable_frequency_sketch(), it is counted in the 
+	// sketch. A separate name, so that a (key, size) call cannot fall through 
+	// to on_access(size, tenant). 
+	void on_keyed_access(key_type key, osize_t osize, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_ACCESS);
+		log_event(EV_KEYED_ACCESS, osize, tenant, key);
+		record_access(osize, tenant);
+		if constexpr (Features::per_key_tracking) {
+			last_access = A_UNKEYED;
+			if (frequency_sketch.enabled()) {
+				frequency_sketch.update(key);
+			}
+			if (shadow.enabled()) {
+				bool first = !seen_keys.find(key);
+				if (first) {
+					seen_keys[key] = 1;
+				}
+				bool shadow_hit = shadow.access(key, osize);
+				last_access = first ? A_FIRST : 
+					(shadow_hit ? A_SHADOW_HIT : A_SHADOW_MISS);
+			}
+		}
 	}
 
-	void on_hit(osize_t osize) {
-		counters["total_hits"].increment(osize);
+	void on_hit(osize_t osize, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_HIT);
+		log_event(EV_HIT, osize, tenant);
+		counters[C_TOTAL_HITS].increment(osize);
+		record_partitions(P_HITS, tenant, osize);
+		update_ewma(osize, true);
 	}
 
 	void on_dram_hit(osize_t osize) {
-		counters["dram_hits"].increment(osize);
+		log_event(EV_DRAM_HIT, osize, 0);
+		counters[C_DRAM_HITS].increment(osize);
+		if constexpr (Features::tiers) {
+			if (tier_stats.enabled()) {
+				tier_stats.on_hit(TIER_DRAM, osize);
+			}
+		}
 	}
 
 	void on_dram_miss(osize_t osize) {
-		counters["dram_misses"].increment(osize);
+		log_event(EV_DRAM_MISS, osize, 0);
+		counters[C_DRAM_MISSES].increment(osize);
+		if constexpr (Features::tiers) {
+			if (tier_stats.enabled()) {
+				tier_stats.on_miss(TIER_DRAM, osize);
+			}
+		}
+	}
+
+	void on_tier_hit(tier_t tier, osize_t osize) {
+		log_event(EV_TIER_HIT, osize, 0, tier);
+		if constexpr (Features::tiers) {
+			if (tier_stats.enabled()) {
+				tier_stats.on_hit(tier, osize);
+			}
+		}
+	}
+
+	void on_tier_miss(tier_t tier, osize_t osize) {
+		log_event(EV_TIER_MISS, osize, 0, tier);
+		if constexpr (Features::tiers) {
+			if (tier_stats.enabled()) {
+				tier_stats.on_miss(tier, osize);
+			}
+		}
+	}
+
+	// Shorthand for a miss in every tier above `tier` and a hit in it
+	void on_served_from(tier_t tier, osize_t osize) {
+		log_event(EV_SERVED_FROM, osize, 0, tier);
+		if constexpr (Features::tiers) {
+			if (tier_stats.enabled()) {
+				tier_stats.on_served_from(tier, osize);
+			}
+		}
 	}
 
 	std::string dump_counters_as_json() {
 		std::string str = "{\n";
 		
-		for (auto it : counters) {
-			str += "\"" + it.first + "\": \n"; 
-			str += it.second.to_json(); 
-			str += ",\n"; 
-		}
+		str += counters.to_json(); 
 
 		str += "\"segment_period\": " + std::to_string(inst_stats_period) + ",\n"; 
 
+		if (tenant_stats.enabled()) {
+			str += tenant_stats.to_json("tenants") + ",\n"; 
+		}
+		if (size_class_stats.enabled()) {
+			str += size_classes.to_json("size_class_bounds") + ",\n"; 
+			str += size_class_stats.to_json("size_classes") + ",\n"; 
+		}
+		if (tier_stats.enabled()) {
+			str += tier_stats.to_json("tiers") + ",\n"; 
+		}
+		if constexpr (Features::profiling) {
+			str += profile.to_json("callback_profile") + ",\n"; 
+		}
+		if (frequency_sketch.enabled()) {
+			str += frequency_sketch.to_json("frequency_sketch") + ",\n"; 
+		}
+		if (shadow.enabled()) {
+			str += print_segment_data(
+					segment_compulsory_misses, "segment_compulsory_misses") + ",\n"; 
+			str += print_segment_data(
+					segment_capacity_misses, "segment_capacity_misses") + ",\n"; 
+			str += print_segment_data(
+					segment_conflict_misses, "segment_conflict_misses") + ",\n"; 
+		}
+
 		str += print_segment_data(
 				segment_bytes_hit, "segment_bytes_hit") + ",\n"; 
 		str += print_segment_data(
@@ -136,3 +528,7 @@ public:
 		return str;
 	}
 };
+
+typedef CacheStatsT<> CacheStats;
+
+#endif  // CACHE_STATS_H
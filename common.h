@@ -11,11 +11,16 @@
 typedef uint32_t okey_t;
 typedef uint32_t osize_t;
 typedef uint64_t counter_t; 
+// Trace time, in seconds
+typedef uint64_t otime_t; 
 
-class Counter {
+// Object counts are 64-bit by default; BasicCounter<uint32_t> keeps the 
+// compact layout for traces known to stay under 2^32 requests. 
+template <typename ObjectCount>
+class BasicCounter {
 public: 
 	counter_t byte_counter = 0;
-	osize_t object_counter = 0;
+	ObjectCount object_counter = 0;
 
 	void increment(osize_t size) {
 		byte_counter += size; 
@@ -29,6 +34,26 @@ public:
 	}
 };
 
-std::string print_segment_data(std::vector<size_t>, std::string); 
+typedef BasicCounter<uint64_t> Counter; 
+typedef BasicCounter<uint32_t> CompactCounter; 
+
+template <typename T>
+std::string print_segment_data(std::vector<T> const &data, std::string name) {
+	std::string str = ""; 
+	str += "\"" + name + "\": ["; 
+	if (data.empty()) {
+		return str + "]";
+	}
+	for (size_t i = 0; i < data.size() - 1; ++i) {
+		str += std::to_string(data[i]) + ", "; 
+	}
+	str += std::to_string(data.back()) + "]"; 
+	return str;
+}
+
+extern template std::string print_segment_data(std::vector<size_t> const &, 
+		std::string); 
+extern template std::string print_segment_data(std::vector<double> const &, 
+		std::string); 
 
 #endif  // STATS_COMMON_H
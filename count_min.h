@@ -0,0 +1,125 @@
+#ifndef COUNT_MIN_H
+#define COUNT_MIN_H
+
+#include "common.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Count-Min sketch of access frequencies with periodic halving, for
+ * frequency-based admission. Each key hashes to one 64-byte block (one cache
+ * line) holding its DEPTH rows of 16 saturating 8-bit counters, so an update
+ * or query touches a single line; with SSE2 an update is one compare and
+ * saturating add per row, with no branches. After `sample_size` updates
+ * every counter is halved, so estimates track recent popularity (as in
+ * TinyLFU).
+ */
+class CountMinSketch {
+public:
+	static const size_t DEPTH = 4;
+	static const size_t ROW_COUNTERS = 16;
+	static const size_t BLOCK_BYTES = DEPTH * ROW_COUNTERS;
+
+	struct alignas(64) Block {
+		uint8_t counters[BLOCK_BYTES];
+	};
+
+	std::vector<Block> blocks;
+	size_t mask = 0;
+	uint64_t sample_size = 0;
+	uint64_t updates = 0;
+	uint64_t halvings = 0;
+
+	CountMinSketch() {}
+
+	// Room for about `counters` counters per row, rounded up to a power of
+	// two number of blocks. sample_size 0 means 10 * counters.
+	CountMinSketch(size_t counters, uint64_t sample = 0) {
+		size_t n = 1;
+		while (n * ROW_COUNTERS < counters) {
+			n <<= 1;
+		}
+		blocks.resize(n, Block{});
+		mask = n - 1;
+		sample_size = sample ? sample : 10 * n * ROW_COUNTERS;
+	}
+
+	bool enabled() const {
+		return !blocks.empty();
+	}
+
+	static uint64_t hash(uint64_t key) {
+		uint64_t h = key * 0x9e3779b97f4a7c15ull;
+		h ^= h >> 29;
+		h *= 0xbf58476d1ce4e5b9ull;
+		return h ^ (h >> 32);
+	}
+
+	// Block from the low bits, a 4-bit slot per row from the high bits
+	Block &block_of(uint64_t h) {
+		return blocks[h & mask];
+	}
+
+	static size_t slot(uint64_t h, size_t row) {
+		return (h >> (48 + 4 * row)) & (ROW_COUNTERS - 1);
+	}
+
+	void update(uint64_t key) {
+		uint64_t h = hash(key);
+		Block &b = block_of(h);
+#if defined(__SSE2__)
+		const __m128i lanes = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 
+				8, 9, 10, 11, 12, 13, 14, 15);
+		const __m128i one = _mm_set1_epi8(1);
+		for (size_t row = 0; row < DEPTH; ++row) {
+			__m128i *p = (__m128i *)(b.counters + row * ROW_COUNTERS);
+			__m128i hit = _mm_cmpeq_epi8(lanes, _mm_set1_epi8((char)slot(h, row)));
+			_mm_store_si128(p, _mm_adds_epu8(_mm_load_si128(p), 
+						_mm_and_si128(hit, one)));
+		}
+#else
+		for (size_t row = 0; row < DEPTH; ++row) {
+			uint8_t &c = b.counters[row * ROW_COUNTERS + slot(h, row)];
+			c += c < UINT8_MAX;
+		}
+#endif
+		if (++updates == sample_size) {
+			halve();
+		}
+	}
+
+	uint32_t estimate(uint64_t key) {
+		uint64_t h = hash(key);
+		Block &b = block_of(h);
+		uint8_t est = UINT8_MAX;
+		for (size_t row = 0; row < DEPTH; ++row) {
+			est = std::min(est, b.counters[row * ROW_COUNTERS + slot(h, row)]);
+		}
+		return est;
+	}
+
+	// Plain byte loop; compilers vectorize it
+	void halve() {
+		uint8_t *c = blocks[0].counters;
+		size_t n = blocks.size() * BLOCK_BYTES;
+		for (size_t i = 0; i < n; ++i) {
+			c[i] >>= 1;
+		}
+		updates = 0;
+		halvings++;
+	}
+
+	std::string to_json(std::string name) const {
+		std::string str = "\"" + name + "\": {";
+		str += "\"counters_per_row\": " + 
+			std::to_string(blocks.size() * ROW_COUNTERS) + ", ";
+		str += "\"depth\": " + std::to_string(DEPTH) + ", ";
+		str += "\"sample_size\": " + std::to_string(sample_size) + ", ";
+		str += "\"halvings\": " + std::to_string(halvings) + "}";
+		return str;
+	}
+};
+
+#endif  // COUNT_MIN_H
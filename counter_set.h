@@ -0,0 +1,77 @@
+#ifndef COUNTER_SET_H
+#define COUNTER_SET_H
+
+#include "common.h"
+
+#include <array>
+#include <bitset>
+#include <stdexcept>
+
+/*
+ * The named global counters of a stats class, in a fixed array indexed by a
+ * small integer ID (the owner's enum), so a callback bumps one with a single
+ * indexed add and no string hashing. Names are only used for dumping and by
+ * the lookup-by-name operator, which is meant for reports and tools.
+ *
+ * Only counters marked present are dumped: those shown at construction or
+ * with show(), and any looked up by name. Counters of features that were
+ * never enabled stay out of the dump.
+ */
+template <typename CounterT, size_t N>
+class CounterSet {
+public:
+	std::array<CounterT, N> values{};
+	std::array<const char *, N> names;
+	std::bitset<N> present;
+
+	CounterSet(std::array<const char *, N> n)
+		: names(n) {
+		present.set();
+	}
+
+	CounterT &operator[](size_t id) {
+		return values[id];
+	}
+
+	CounterT &operator[](std::string const &name) {
+		size_t id = find(name);
+		if (id == N) {
+			throw std::out_of_range("unknown counter " + name);
+		}
+		present.set(id);
+		return values[id];
+	}
+
+	// ID of the counter called name, or N if there is none
+	size_t find(std::string const &name) const {
+		for (size_t id = 0; id < N; ++id) {
+			if (name == names[id]) {
+				return id;
+			}
+		}
+		return N;
+	}
+
+	void show(size_t id) {
+		present.set(id);
+	}
+
+	void hide(size_t id) {
+		present.reset(id);
+	}
+
+	// One "name": {bytes, objects}, entry per present counter
+	std::string to_json() {
+		std::string str;
+		for (size_t id = 0; id < N; ++id) {
+			if (present[id]) {
+				str += "\"" + std::string(names[id]) + "\": \n";
+				str += values[id].to_json();
+				str += ",\n";
+			}
+		}
+		return str;
+	}
+};
+
+#endif  // COUNTER_SET_H
@@ -0,0 +1,95 @@
+#ifndef COUNTERFACTUAL_STATS_H
+#define COUNTERFACTUAL_STATS_H
+
+#include "common.h"
+#include "histogram.h"
+#include "key_history.h"
+
+/*
+ * What a write-saving decision cost in hits. Keys the cache declined to
+ * write (skipped inserts, pruned copy-forwards) are remembered in a bounded
+ * KeyHistory; a later miss on one is a hit the decision gave up, counted with
+ * its delay in requests since the decision. Hits are charged only while the
+ * key is in the history and at most once per decision, so this is an
+ * estimate that ignores whether the object would have survived in the cache
+ * that long.
+ *
+ * "lost_hits": bytes and objects of those misses
+ * "lost_hit_bytes_per_saved_byte": lost-hit bytes over the bytes the
+ * 	decisions saved writing
+ */
+class CounterfactualStats {
+public:
+	KeyHistory history;
+	Counter saved;
+	Counter lost_hits;
+	Log2Histogram delay_hist;
+
+	uint64_t last_saved_bytes = 0;
+	uint64_t last_lost_bytes = 0;
+	std::vector<size_t> segment_saved_bytes;
+	std::vector<size_t> segment_lost_bytes;
+
+	CounterfactualStats() {}
+
+	CounterfactualStats(size_t entries)
+		: history(entries) {
+	}
+
+	bool enabled() const {
+		return history.enabled();
+	}
+
+	void on_decision(uint64_t key, osize_t osize, uint32_t now) {
+		saved.increment(osize);
+		history.record(key, now);
+	}
+
+	// The key was written after all; later misses are not this decision's
+	void on_written(uint64_t key) {
+		uint32_t t;
+		history.remove(key, &t);
+	}
+
+	void on_miss(uint64_t key, osize_t osize, uint32_t now) {
+		uint32_t t;
+		if (history.remove(key, &t)) {
+			lost_hits.increment(osize);
+			delay_hist.add(now - t);
+		}
+	}
+
+	static double ratio(uint64_t num, uint64_t den) {
+		return den ? (double)num/den : 0;
+	}
+
+	void collect_periodic_stats() {
+		segment_saved_bytes.push_back(saved.byte_counter - last_saved_bytes);
+		last_saved_bytes = saved.byte_counter;
+		segment_lost_bytes.push_back(lost_hits.byte_counter - last_lost_bytes);
+		last_lost_bytes = lost_hits.byte_counter;
+	}
+
+	std::string to_json(std::string name) {
+		std::vector<double> segment_ratio(segment_saved_bytes.size());
+		for (size_t i = 0; i < segment_ratio.size(); ++i) {
+			segment_ratio[i] = ratio(segment_lost_bytes[i], segment_saved_bytes[i]);
+		}
+
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"history_entries\": " + std::to_string(history.ring.size()) + ",\n";
+		str += "\"saved\": \n" + saved.to_json() + ",\n";
+		str += "\"lost_hits\": \n" + lost_hits.to_json() + ",\n";
+		str += "\"lost_hit_bytes_per_saved_byte\": " + 
+			std::to_string(ratio(lost_hits.byte_counter, saved.byte_counter)) + ",\n";
+		str += delay_hist.to_json("delay_hist") + ",\n";
+		str += print_segment_data(segment_saved_bytes, "segment_saved_bytes") + ",\n";
+		str += print_segment_data(segment_lost_bytes, "segment_lost_hit_bytes") + ",\n";
+		str += print_segment_data(segment_ratio, 
+				"segment_lost_hit_bytes_per_saved_byte") + "\n";
+		str += "}";
+		return str;
+	}
+};
+
+#endif  // COUNTERFACTUAL_STATS_H
@@ -0,0 +1,102 @@
+#ifndef ENDURANCE_STATS_H
+#define ENDURANCE_STATS_H
+
+#include "common.h"
+#include "gc_stats.h"
+
+#include <algorithm>
+
+/*
+ * Flash wear from the container write pattern. Each container is taken to be
+ * one erase block; a program/erase cycle is counted when the container is
+ * programmed (flushed), so a block written once and never erased has worn one
+ * cycle. Counts saturate at 2^16 - 1. The device has device_bytes/
+ * container_bytes blocks, and the mean and percentiles are taken over all of
+ * them, written or not; container IDs past that count add blocks.
+ *
+ * DWPD is device writes (flash_bytes_written, padding included) per day of
+ * trace time over the configured device capacity. Projected lifetime scales
+ * the elapsed trace time by rated/consumed cycles: "lifetime_days" against the
+ * most worn block, as the device sees it, and "ideal_lifetime_days" against
+ * the mean, i.e. with perfect wear leveling. Both are 0 until some trace time
+ * has passed.
+ */
+class EnduranceStats {
+public:
+	size_t device_bytes = 0;
+	size_t container_bytes = 0;
+	uint32_t rated_pe_cycles = 0;
+	std::vector<uint16_t> pe_cycles;
+	uint64_t total_cycles = 0;
+	uint16_t max_cycles = 0;
+
+	EnduranceStats() {}
+
+	EnduranceStats(size_t capacity, size_t block_bytes, uint32_t rated)
+		: device_bytes(capacity), container_bytes(block_bytes), 
+		rated_pe_cycles(rated),
+		pe_cycles(std::max((size_t)1, capacity/std::max((size_t)1, block_bytes)), 
+				0) {
+	}
+
+	bool enabled() const {
+		return device_bytes != 0;
+	}
+
+	void on_program(container_t id) {
+		if (id >= pe_cycles.size()) {
+			pe_cycles.resize((size_t)id + 1, 0);
+		}
+		if (pe_cycles[id] == UINT16_MAX) {
+			return;
+		}
+		total_cycles++;
+		max_cycles = std::max(max_cycles, ++pe_cycles[id]);
+	}
+
+	double mean_cycles() const {
+		return pe_cycles.empty() ? 0 : (double)total_cycles/pe_cycles.size();
+	}
+
+	uint16_t percentile_cycles(double p) const {
+		if (pe_cycles.empty()) {
+			return 0;
+		}
+		std::vector<uint16_t> sorted(pe_cycles);
+		size_t rank = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+		std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+		return sorted[rank];
+	}
+
+	double dwpd(size_t bytes_written, double days) const {
+		return days > 0 ? (double)bytes_written/device_bytes/days : 0;
+	}
+
+	double projected_days(double cycles, double days) const {
+		return cycles > 0 && days > 0 ? days * rated_pe_cycles/cycles : 0;
+	}
+
+	std::string to_json(std::string name, size_t bytes_written, 
+			double days) const {
+		double mean = mean_cycles();
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"device_bytes\": " + std::to_string(device_bytes) + ",\n";
+		str += "\"blocks\": " + std::to_string(pe_cycles.size()) + ",\n";
+		str += "\"rated_pe_cycles\": " + std::to_string(rated_pe_cycles) + ",\n";
+		str += "\"trace_days\": " + std::to_string(days) + ",\n";
+		str += "\"pe_max\": " + std::to_string(max_cycles) + ",\n";
+		str += "\"pe_mean\": " + std::to_string(mean) + ",\n";
+		str += "\"pe_p99\": " + std::to_string(percentile_cycles(0.99)) + ",\n";
+		str += "\"wear_skew\": " + 
+			std::to_string(mean > 0 ? max_cycles/mean : 0) + ",\n";
+		str += "\"dwpd\": " + std::to_string(dwpd(bytes_written, days)) + ",\n";
+		str += "\"lifetime_days\": " + 
+			std::to_string(projected_days(max_cycles, days)) + ",\n";
+		str += "\"ideal_lifetime_days\": " + 
+			std::to_string(projected_days(mean, days)) + "\n";
+		str += "}";
+		return str;
+	}
+};
+
+#endif  // ENDURANCE_STATS_H
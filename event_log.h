@@ -0,0 +1,203 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "common.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+enum EventType : uint8_t {
+	EV_ACCESS,
+	EV_HIT,
+	EV_MISS,
+	EV_INSERT,
+	EV_SKIPPED_INSERT,
+	EV_COPYFWD,
+	EV_SKIPPED_COPYFWD,
+	EV_ERASE,
+	EV_EVICT,
+	EV_WRITE,
+	EV_CONTAINER_FLUSH,
+	EV_CONTAINER_ERASE,
+	EV_DRAM_HIT,
+	EV_DRAM_MISS,
+	EV_SEGMENT,  // collect_periodic_stats
+	EV_INVALIDATE,
+	EV_ADMISSION_REJECT,
+	EV_KEYED_ACCESS,  // CacheStats::on_keyed_access
+	EV_TIER_HIT,
+	EV_TIER_MISS,
+	EV_SERVED_FROM,
+	EV_SET_HIT,  // follows the EV_HIT of the same hit
+	EV_SET_WRITE,  // follows the EV_WRITE of the same write
+	EV_SET_FILL,
+};
+
+enum EventSource : uint8_t {
+	SRC_CACHE,
+	SRC_FLASH,
+};
+
+/*
+ * One stats callback, as written to the event log. Fields a callback does not
+ * have are 0 (e.g. the key for unkeyed CacheStats events). For container
+ * events, size is the unused capacity (flush) and key the container ID where
+ * known. Tier events carry the tier ID and set events the set ID as the key;
+ * for EV_SET_FILL, size is the set's occupied bytes.
+ */
+struct EventRecord {
+	uint64_t key;
+	uint32_t size;
+	uint8_t type;
+	uint8_t source;
+	uint16_t tenant;
+};
+static_assert(sizeof(EventRecord) == 16, "EventRecord must stay packed");
+
+// First record-sized block of an event log file
+struct EventLogHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+};
+static_assert(sizeof(EventLogHeader) == sizeof(EventRecord),
+		"header must be one record long");
+
+const char EVENT_LOG_MAGIC[8] = {'S', 'T', 'A', 'T', 'S', 'E', 'V', 'L'};
+const uint32_t EVENT_LOG_VERSION = 1;
+
+/*
+ * Single-producer, single-consumer ring buffer of EventRecords, drained to a
+ * file by a background thread. The simulator thread (the only producer; all
+ * stats objects sharing a log must be called from it) only copies the record
+ * and bumps an index. The writer thread waits until at least flush_records
+ * have accumulated and writes them straight from the ring in one or two
+ * large write() calls. If the ring is full the producer yields until space
+ * frees up, so no events are lost; producer_stalls counts those waits.
+ */
+class EventLog {
+public:
+	std::vector<EventRecord> ring;
+	size_t mask;
+	size_t flush_records;
+	int fd = -1;
+
+	alignas(64) std::atomic<size_t> head{0};  // next slot to fill
+	size_t cached_tail = 0;  // producer's last view of tail
+	uint64_t producer_stalls = 0;
+
+	alignas(64) std::atomic<size_t> tail{0};  // next slot to write out
+	std::atomic<bool> stopping{false};
+	uint64_t records_written = 0;
+
+	std::thread writer;
+
+	// capacity is rounded up to a power of two
+	EventLog(std::string path, size_t capacity = (size_t)1 << 22,
+			size_t flush = (size_t)1 << 16) {
+		size_t cap = 1;
+		while (cap < capacity) {
+			cap <<= 1;
+		}
+		ring.resize(cap);
+		mask = cap - 1;
+		flush_records = std::min(flush, cap / 2);
+
+		fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw std::runtime_error("Cannot open event log " + path);
+		}
+		EventLogHeader header;
+		std::memcpy(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic));
+		header.version = EVENT_LOG_VERSION;
+		header.record_size = sizeof(EventRecord);
+		write_all(&header, sizeof(header));
+
+		writer = std::thread([this] { drain(); });
+	}
+
+	~EventLog() {
+		close();
+	}
+
+	EventLog(const EventLog &) = delete;
+	EventLog &operator=(const EventLog &) = delete;
+
+	void push(const EventRecord &e) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - cached_tail > mask) {
+			cached_tail = tail.load(std::memory_order_acquire);
+			while (h - cached_tail > mask) {
+				producer_stalls++;
+				std::this_thread::yield();
+				cached_tail = tail.load(std::memory_order_acquire);
+			}
+		}
+		ring[h & mask] = e;
+		head.store(h + 1, std::memory_order_release);
+	}
+
+	// Flush everything pushed so far and stop the writer. Must be called
+	// from the producer thread (or after it is done).
+	void close() {
+		if (fd < 0) {
+			return;
+		}
+		stopping.store(true, std::memory_order_release);
+		writer.join();
+		::close(fd);
+		fd = -1;
+	}
+
+	void drain() {
+		while (true) {
+			// Read stopping before head, so a final head is seen in full
+			bool stop = stopping.load(std::memory_order_acquire);
+			size_t h = head.load(std::memory_order_acquire);
+			size_t t = tail.load(std::memory_order_relaxed);
+			size_t available = h - t;
+
+			if (available >= flush_records || (stop && available)) {
+				size_t n = std::min(available, flush_records);
+				size_t idx = t & mask;
+				size_t first = std::min(n, ring.size() - idx);
+				write_all(&ring[idx], first * sizeof(EventRecord));
+				if (n > first) {
+					write_all(&ring[0], (n - first) * sizeof(EventRecord));
+				}
+				records_written += n;
+				tail.store(t + n, std::memory_order_release);
+				continue;
+			}
+			if (stop) {
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	void write_all(const void *buf, size_t len) {
+		const char *p = (const char *)buf;
+		while (len) {
+			ssize_t n = ::write(fd, p, len);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n < 0) {
+				std::cerr << "Event log write failed" << std::endl;
+				return;
+			}
+			p += n;
+			len -= n;
+		}
+	}
+};
+
+#endif  // EVENT_LOG_H
@@ -0,0 +1,89 @@
+#ifndef EWMA_H
+#define EWMA_H
+
+#include "common.h"
+
+#include <cmath>
+
+/*
+ * Exponentially decayed counters for O(1) "current value" queries: every
+ * update and query is a few multiplies, with no lookups or allocation, so a
+ * control loop can read them on every request.
+ */
+
+// Decay factor per step for a given half-life in steps
+inline double half_life_decay(double half_life) {
+	return half_life > 0 ? std::exp2(-1.0/half_life) : 0;
+}
+
+/*
+ * Ratio of two decayed sums, num/den, both decayed by the same factor per
+ * step(). With num the bytes hit and den the bytes read of each request,
+ * stepped once per request, value() is the recent byte hit ratio.
+ */
+class DecayedRatio {
+public:
+	double decay = 0;
+	double num = 0;
+	double den = 0;
+
+	DecayedRatio() {}
+
+	DecayedRatio(double half_life)
+		: decay(half_life_decay(half_life)) {
+	}
+
+	bool enabled() const {
+		return decay != 0;
+	}
+
+	void step() {
+		num *= decay;
+		den *= decay;
+	}
+
+	double value() const {
+		return den > 0 ? num/den : 0;
+	}
+};
+
+/*
+ * Recent rate per unit of an external clock (e.g. trace seconds): a sum
+ * decayed by `decay` per elapsed unit, scaled to the steady-state rate.
+ * Time only moves forward; decaying is done lazily when it has moved.
+ */
+class DecayedRate {
+public:
+	double decay = 0;
+	double sum = 0;
+	otime_t last = 0;
+
+	DecayedRate() {}
+
+	DecayedRate(double half_life)
+		: decay(half_life_decay(half_life)) {
+	}
+
+	bool enabled() const {
+		return decay != 0;
+	}
+
+	void advance(otime_t now) {
+		if (now > last) {
+			sum *= std::pow(decay, (double)(now - last));
+			last = now;
+		}
+	}
+
+	void add(otime_t now, double amount) {
+		advance(now);
+		sum += amount;
+	}
+
+	double value(otime_t now) {
+		advance(now);
+		return sum * (1 - decay);
+	}
+};
+
+#endif  // EWMA_H
@@ -2,11 +2,30 @@
 #define FLASH_STATS_H
 
 #include "common.h"
+#include "counter_set.h"
+#include "counterfactual_stats.h"
+#include "endurance_stats.h"
+#include "event_log.h"
+#include "ewma.h"
+#include "flat_map.h"
+#include "ftl_sim.h"
+#include "gc_stats.h"
+#include "heavy_hitters.h"
+#include "histogram.h"
+#include "key_history.h"
+#include "partition_stats.h"
+#include "profiler.h"
+#include "set_stats.h"
+#include "space_stats.h"
+#include "stats_features.h"
+#include "zns_stats.h"
+#include <algorithm>
 #include <cmath>
 #include <numeric>
 #include <set>
 
-class FlashStats {
+template <typename Features = DefaultStatsFeatures>
+class FlashStatsT {
 public: 
 	/*
 	* === Various types of misses; first is bytes, second is objects
@@ -17,7 +36,7 @@ public:
 	* "bad_choice_misses": misses on objects that we evicted but the caching 
 		* algorithm might have kept
 		* (i.e., we forced an eviction on the object)
-		* Currently we're not getting any such misses; fill this in later
+		* Counted from the ghost cache; see enable_ghost_cache()
 	*
 	* === Various types of hits
 	* "total_hits" : includes all hit types. 
@@ -28,12 +47,119 @@ public:
 	* "reinserts": re-inserted by caching algorithm evictions (CLWA)
 	* "skipped_inserts": ...skipped insertion
 	*
+	* === Evictions
+	* "evictions": objects evicted by the caching algorithm, dropped at 
+	* 	container erase (on_erase) or earlier (on_evict)
+	* "invalidations": objects overwritten or deleted before their container 
+	* 	was erased (on_invalidate)
+	*
 	* === Bytes written
 	* "objects_written"
 	* flash_bytes_written: object bytes written + headers, unused space in zones, etc.
 	* unused_bytes: overhead in containers that isn't used for anything
 	*/
-	std::unordered_map<std::string, Counter> counters; 
+	typedef typename Features::key_type key_type;
+	typedef typename Features::counter_type counter_type;
+
+	// Global counters, indexed by CounterId; names are only for the dump
+	enum CounterId {
+		C_TOTAL_READS,
+		C_TOTAL_MISSES,
+		C_TOTAL_HITS,
+		C_COMPULSORY_MISSES,
+		C_CAPACITY_MISSES,
+		C_WA_SKIP_MISSES,
+		C_ONE_HIT_MISSES,
+		C_COPYFWD_HITS,
+		C_COPY_FORWARDS,
+		C_FLASH_INSERTS,
+		C_REINSERTS,
+		C_SKIPPED_COPYFWDS,
+		C_SKIPPED_INSERTS,
+		C_TOTAL_PLACEMENTS,
+		C_EVICTIONS,
+		C_INVALIDATIONS,
+		C_BAD_CHOICE_MISSES,
+		C_OBJECTS_WRITTEN,
+		NUM_COUNTERS,
+	};
+	static constexpr std::array<const char *, NUM_COUNTERS> counter_names = {
+		"total_reads",
+		"total_misses",
+		"total_hits",
+		"compulsory_misses",
+		"capacity_misses",
+		"wa_skip_misses",
+		"one_hit_misses",
+		"copyfwd_hits",
+		"copy_forwards",
+		"flash_inserts",
+		"reinserts",
+		"skipped_copyfwds",
+		"skipped_inserts",
+		"total_placements",
+		"evictions",
+		"invalidations",
+		"bad_choice_misses",
+		"objects_written",
+	};
+	CounterSet<counter_type, NUM_COUNTERS> counters; 
+	// Counters added by increment_custom_counter() under other names
+	std::unordered_map<std::string, counter_type> custom_counters; 
+
+	// Per-tenant and per-size-class copies of the request and write counters;
+	// see enable_tenant_stats() and enable_size_class_stats(). Container 
+	// padding (on_container_flush) is not attributable to a partition, so 
+	// per-partition WA is objects_written over flash_inserts. 
+	enum PartitionCounter {
+		P_READS,
+		P_HITS,
+		P_MISSES,
+		P_INSERTS,
+		P_SKIPPED_INSERTS,
+		P_COPY_FORWARDS,
+		P_SKIPPED_COPYFWDS,
+		P_OBJECTS_WRITTEN,
+	};
+	PartitionedCounters tenant_stats; 
+	PartitionedCounters size_class_stats; 
+	SizeClassMap size_classes; 
+
+	// Live data destroyed or copied by each container erase; see 
+	// on_container_erase(container_t, size_t, size_t)
+	GcStats gc_stats; 
+
+	// Valid, invalid and padding bytes on flash
+	SpaceStats space; 
+
+	// Per-set writes, hits and fill for set-associative layers; see 
+	// enable_set_stats()
+	SetStats set_stats; 
+
+	// P/E cycles per container and projected lifetime; see 
+	// enable_endurance_model()
+	EnduranceStats endurance; 
+
+	// Device-level GC underneath the containers; see enable_ftl_model()
+	FtlSim ftl; 
+
+	// Zone appends, resets and write pointers; see enable_zns_mode()
+	ZnsStats zns; 
+
+	// Decayed flash write rate and WA for online feedback; see enable_ewma()
+	DecayedRate recent_write_rate; 
+	DecayedRatio recent_wa; 
+
+	// Trace time of the first and latest request; see set_trace_time()
+	otime_t start_time = 0; 
+	otime_t now = 0; 
+	bool time_set = false; 
+
+	// Time spent in each callback, when the policy enables profiling
+	CallbackProfile profile; 
+
+	// Raw event trace; see attach_event_log()
+	EventLog *event_log = nullptr; 
 
 	/* Bit mappings (if true...): 
 	 * INSERTED: was at some point inserted
@@ -66,36 +192,208 @@ public:
 		CF, 
 	};
 
-	std::unordered_map<okey_t, std::bitset<8>> cached; 
-	std::set<okey_t> seen;
+	std::unordered_map<key_type, std::bitset<8>> cached; 
+	std::set<key_type> seen;
 	std::vector<uint32_t> copyfwd_hist; 
-	std::unordered_map<okey_t, uint8_t> copyfwds; 
+	std::unordered_map<key_type, uint8_t> copyfwds; 
+
+	// Flash request clock (on_access calls), and the clock value when each 
+	// cached key was inserted, for the age of an object at eviction. Ages 
+	// are in requests, mod 2^32. 
+	uint64_t requests = 0; 
+	FlatMap<key_type, uint32_t> insert_times; 
+	Log2Histogram eviction_age_hist; 
+
+	// Recently evicted keys, for bad-choice misses
+	KeyHistory ghost; 
+
+	// Keys with the most missed bytes and the most bytes written (inserts 
+	// and copy-forwards); see enable_heavy_hitters()
+	HeavyHitters<key_type> miss_hitters; 
+	HeavyHitters<key_type> write_hitters; 
+
+	// Later misses on keys whose insert was skipped; see 
+	// enable_admission_analysis()
+	CounterfactualStats skipped_insert_analysis; 
+	// ...and on keys whose copy-forward was pruned; see 
+	// enable_copyfwd_analysis()
+	CounterfactualStats pruned_copyfwd_analysis; 
 
 	int inst_stats_period; 
 
-	FlashStats(int m, bool r) 
-		: copyfwd_hist(256, 0), inst_stats_period(m),
-		record_segment_byte_breakdown(r) {
-		counters = {
-			{"total_reads", {}},
-			{"total_misses", {}}, 
-			{"total_hits", {}},
-			{"compulsory_misses", {}},
-			{"capacity_misses", {}},
-			{"wa_skip_misses", {}}, 
-			{"one_hit_misses", {}},
-			{"copyfwd_hits", {}}, 
-			{"copy_forwards", {}},
-			{"flash_inserts", {}},
-			{"reinserts", {}},
-			{"skipped_copyfwds", {}}, 
-			{"skipped_inserts", {}},
-			{"total_placements", {}}, 
-		};
-		std::cout << (record_segment_byte_breakdown? "Recording " : "Not recording ") << 
+	FlashStatsT(int m, bool r) 
+		: counters(counter_names), 
+		copyfwd_hist(Features::histograms ? 256 : 0, 0), 
+		inst_stats_period(m), record_segment_byte_breakdown(r) {
+		std::cout << (recording_breakdown()? "Recording " : "Not recording ") << 
 			"segment byte breakdown!" << std::endl;
 	}
 
+	// Keep every counter and segment series per tenant as well. Events then
+	// carry a tenant ID in [0, num_tenants); events with any other ID are 
+	// left out of the tenant split and counted as out of range. 
+	void enable_tenant_stats(size_t num_tenants) {
+		static_assert(Features::partitions, "partitions disabled by policy");
+		tenant_stats = PartitionedCounters(partition_counter_names(), 
+				num_tenants);
+	}
+
+	// Keep every counter and segment series per object size class as well, 
+	// with class boundaries as described in SizeClassMap. 
+	void enable_size_class_stats(std::vector<osize_t> boundaries) {
+		static_assert(Features::partitions, "partitions disabled by policy");
+		size_classes = SizeClassMap(boundaries);
+		size_class_stats = PartitionedCounters(partition_counter_names(), 
+				size_classes.num_classes);
+	}
+
+	// Remember the last `entries` keys evicted by the policy (on_erase and 
+	// on_evict, not overwrites or deletes); a miss on one of them is a 
+	// bad-choice miss. 
+	void enable_ghost_cache(size_t entries) {
+		static_assert(Features::per_key_tracking, 
+				"per-key tracking disabled by policy");
+		ghost = KeyHistory(entries);
+	}
+
+	// Track the top_k keys by missed bytes and by bytes written, overall and 
+	// per segment, with `num_counters` Space-Saving counters each (more 
+	// counters, tighter estimates). 
+	void enable_heavy_hitters(size_t num_counters, size_t top_k = 10) {
+		static_assert(Features::per_key_tracking, 
+				"per-key tracking disabled by policy");
+		miss_hitters = HeavyHitters<key_type>(num_counters, top_k);
+		write_hitters = HeavyHitters<key_type>(num_counters, top_k);
+	}
+
+	// Remember the last `entries` skipped inserts and count the hits they 
+	// gave up (later misses on those keys) and how soon they came. 
+	void enable_admission_analysis(size_t entries) {
+		static_assert(Features::per_key_tracking, 
+				"per-key tracking disabled by policy");
+		skipped_insert_analysis = CounterfactualStats(entries);
+	}
+
+	// As above, for the last `entries` pruned copy-forwards
+	void enable_copyfwd_analysis(size_t entries) {
+		static_assert(Features::per_key_tracking, 
+				"per-key tracking disabled by policy");
+		pruned_copyfwd_analysis = CounterfactualStats(entries);
+	}
+
+	// Keep per-set counters for a set-associative layer of num_sets sets of 
+	// set_bytes each, fed by the set-ID on_write()/on_hit() overloads and 
+	// on_set_fill(). The dump lists the top_k sets by writes. 
+	void enable_set_stats(size_t num_sets, size_t set_bytes, 
+			size_t top_k = 10) {
+		static_assert(Features::container_stats, 
+				"container stats disabled by policy");
+		set_stats = SetStats(num_sets, set_bytes, top_k);
+	}
+
+	// Track wear per container, for a device of device_bytes made of 
+	// container_bytes blocks, rated for rated_pe_cycles program/erase cycles 
+	// per block. Needs container IDs from on_container_flush(container_t, 
+	// size_t) and trace time from set_trace_time(). 
+	void enable_endurance_model(size_t device_bytes, size_t container_bytes, 
+			uint32_t rated_pe_cycles) {
+		static_assert(Features::container_stats, 
+				"container stats disabled by policy");
+		endurance = EnduranceStats(device_bytes, container_bytes, 
+				rated_pe_cycles);
+	}
+
+	// Simulate a page-mapped FTL fed by the container flushes and erases. 
+	// Needs container IDs from on_container_flush(container_t, size_t) and 
+	// on_container_erase(container_t, size_t, size_t). 
+	void enable_ftl_model(FtlConfig config) {
+		static_assert(Features::container_stats, 
+				"container stats disabled by policy");
+		ftl = FtlSim(config);
+	}
+
+	// Account container flushes as zone appends and container erases as 
+	// zone resets. Needs the container-ID flush and erase overloads. 
+	void enable_zns_mode(ZnsConfig config) {
+		static_assert(Features::container_stats, 
+				"container stats disabled by policy");
+		zns = ZnsStats(config);
+	}
+
+	// Keep an exponentially decayed flash write rate (half-life in trace 
+	// seconds; needs set_trace_time()) and WA (flash bytes written over bytes 
+	// inserted, half-life in flash requests), for current_write_rate() and 
+	// current_wa(). 
+	void enable_ewma(double half_life_requests, double half_life_seconds) {
+		recent_wa = DecayedRatio(half_life_requests);
+		recent_write_rate = DecayedRate(half_life_seconds);
+		recent_write_rate.last = now;
+	}
+
+	// Flash bytes written per trace second, recently
+	double current_write_rate() {
+		return recent_write_rate.enabled() ? recent_write_rate.value(now) : 0;
+	}
+
+	double current_wa() const {
+		return recent_wa.value();
+	}
+
+	void update_ewma_written(size_t bytes) {
+		if (recent_wa.enabled()) {
+			recent_wa.num += bytes;
+			recent_write_rate.add(now, bytes);
+		}
+	}
+
+	// Current trace time. Call before the callbacks of each request, or at 
+	// least once per period; time-based rates (e.g. DWPD) are 0 without it. 
+	void set_trace_time(otime_t t) {
+		if (!time_set) {
+			start_time = t;
+			time_set = true;
+		}
+		now = t;
+	}
+
+	double elapsed_days() const {
+		return (double)(now - start_time)/86400;
+	}
+
+	// Record every callback in `log` as well. The log is not owned and may be
+	// shared with a CacheStats driven from the same thread. 
+	void attach_event_log(EventLog *log) {
+		static_assert(Features::event_log, "event log disabled by policy");
+		event_log = log;
+	}
+
+	void log_event(EventType type, uint64_t key, osize_t osize, 
+			tenant_t tenant) {
+		if constexpr (Features::event_log) {
+			if (event_log) {
+				event_log->push({key, osize, type, SRC_FLASH, tenant});
+			}
+		}
+	}
+
+	static std::vector<std::string> partition_counter_names() {
+		return {"total_reads", "total_hits", "total_misses", "flash_inserts", 
+				"skipped_inserts", "copy_forwards", "skipped_copyfwds", 
+				"objects_written"};
+	}
+
+	void record_partitions(PartitionCounter counter, tenant_t tenant, 
+			osize_t osize) {
+		if constexpr (Features::partitions) {
+			if (tenant_stats.enabled()) {
+				tenant_stats.increment(counter, tenant, osize);
+			}
+			if (size_class_stats.enabled()) {
+				size_class_stats.increment(counter, size_classes.lookup(osize), osize);
+			}
+		}
+	}
+
 	size_t containers_erased = 0; 
 	size_t containers_written = 0;
 	size_t flash_bytes_written = 0;
@@ -107,8 +405,14 @@ public:
 	size_t last_objectswritten = 0;
 	size_t last_reinserts = 0;
 	size_t last_bytes_written = 0; 
+	counter_type last_evictions; 
+	size_t last_bad_choice = 0; 
 	bool record_segment_byte_breakdown = false;
 
+	bool recording_breakdown() const {
+		return Features::segment_breakdown && record_segment_byte_breakdown;
+	}
+
 	/*
 	 * Want: 
 	 * - X warmup flash bytes written
@@ -126,27 +430,76 @@ public:
 	std::vector<size_t> segment_objectswritten; 
 	std::vector<size_t> segment_reinserts; 
 
+	std::vector<size_t> segment_evicted_bytes; 
+	std::vector<size_t> segment_evicted_objects; 
+	std::vector<size_t> segment_bad_choice_misses; 
+
 	void collect_periodic_stats(size_t total_size) {
+		ProfileScope<Features::profiling> scope(profile, PROF_COLLECT_PERIODIC_STATS);
+		log_event(EV_SEGMENT, 0, 0, 0);
 		segment_fbw.push_back(flash_bytes_written - last_bytes_written); 
 		last_bytes_written = flash_bytes_written; 
 
-		segment_inserts.push_back(counters["flash_inserts"].byte_counter - counters["skipped_inserts"].byte_counter - last_inserts); 
-		last_inserts = counters["flash_inserts"].byte_counter - counters["skipped_inserts"].byte_counter; 
+		segment_inserts.push_back(counters[C_FLASH_INSERTS].byte_counter - counters[C_SKIPPED_INSERTS].byte_counter - last_inserts); 
+		last_inserts = counters[C_FLASH_INSERTS].byte_counter - counters[C_SKIPPED_INSERTS].byte_counter; 
 
-		if (record_segment_byte_breakdown) {
-			segment_copyforwards.push_back(counters["copy_forwards"].byte_counter - last_cfs);
-			last_cfs = counters["copy_forwards"].byte_counter;
+		if (recording_breakdown()) {
+			segment_copyforwards.push_back(counters[C_COPY_FORWARDS].byte_counter - last_cfs);
+			last_cfs = counters[C_COPY_FORWARDS].byte_counter;
 
-			segment_objectswritten.push_back(counters["objects_written"].byte_counter - last_objectswritten);
-			last_objectswritten = counters["objects_written"].byte_counter;
+			segment_objectswritten.push_back(counters[C_OBJECTS_WRITTEN].byte_counter - last_objectswritten);
+			last_objectswritten = counters[C_OBJECTS_WRITTEN].byte_counter;
 
-			segment_reinserts.push_back(counters["reinserts"].byte_counter - last_reinserts);
-			last_reinserts = counters["reinserts"].byte_counter;
+			segment_reinserts.push_back(counters[C_REINSERTS].byte_counter - last_reinserts);
+			last_reinserts = counters[C_REINSERTS].byte_counter;
 		}
 
-		write_amplification = (double)flash_bytes_written/counters["flash_inserts"].byte_counter; 
+		write_amplification = (double)flash_bytes_written/counters[C_FLASH_INSERTS].byte_counter; 
 
 		segment_util.push_back(total_size);
+
+		auto &evictions = counters[C_EVICTIONS];
+		segment_evicted_bytes.push_back(evictions.byte_counter - 
+				last_evictions.byte_counter);
+		segment_evicted_objects.push_back(evictions.object_counter - 
+				last_evictions.object_counter);
+		last_evictions = evictions;
+
+		if (miss_hitters.enabled()) {
+			miss_hitters.collect_periodic_stats();
+			write_hitters.collect_periodic_stats();
+		}
+		if (skipped_insert_analysis.enabled()) {
+			skipped_insert_analysis.collect_periodic_stats();
+		}
+		if (pruned_copyfwd_analysis.enabled()) {
+			pruned_copyfwd_analysis.collect_periodic_stats();
+		}
+		if (ghost.enabled()) {
+			auto bad_choice = counters[C_BAD_CHOICE_MISSES].byte_counter;
+			segment_bad_choice_misses.push_back(bad_choice - last_bad_choice);
+			last_bad_choice = bad_choice;
+		}
+
+		if (tenant_stats.enabled()) {
+			tenant_stats.collect_periodic_stats();
+		}
+		if (size_class_stats.enabled()) {
+			size_class_stats.collect_periodic_stats();
+		}
+		if constexpr (Features::container_stats) {
+			gc_stats.collect_periodic_stats();
+			space.collect_periodic_stats();
+			if (set_stats.enabled()) {
+				set_stats.collect_periodic_stats();
+			}
+			if (ftl.enabled()) {
+				ftl.collect_periodic_stats(counters[C_FLASH_INSERTS].byte_counter);
+			}
+			if (zns.enabled()) {
+				zns.collect_periodic_stats();
+			}
+		}
 	}
 
 	void print_periodic_stats() {
@@ -159,15 +512,34 @@ public:
 	/* 
 	 *
 	 */
-	void on_miss(okey_t key, osize_t osize) {
-		counters["total_misses"].increment(osize);
+	void on_miss(key_type key, osize_t osize, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_MISS);
+		log_event(EV_MISS, key, osize, tenant);
+		counters[C_TOTAL_MISSES].increment(osize);
+		record_partitions(P_MISSES, tenant, osize);
+
+		if constexpr (Features::per_key_tracking) {
+			uint32_t evicted;
+			if (ghost.enabled() && ghost.remove(key, &evicted)) {
+				counters[C_BAD_CHOICE_MISSES].increment(osize);
+			}
+			if (skipped_insert_analysis.enabled()) {
+				skipped_insert_analysis.on_miss(key, osize, (uint32_t)requests);
+			}
+			if (pruned_copyfwd_analysis.enabled()) {
+				pruned_copyfwd_analysis.on_miss(key, osize, (uint32_t)requests);
+			}
+			if (miss_hitters.enabled()) {
+				miss_hitters.update(key, osize);
+			}
+		}
 
 		/*
 		auto it = cached.find(key); 
 		bool compulsory_miss = it == cached.end();
 
 		if (compulsory_miss) {
-			counters["compulsory_misses"].increment(osize); 
+			counters[C_COMPULSORY_MISSES].increment(osize); 
 			cached[key] = 0; 
 		} else {
 			// We've seen this before
@@ -177,7 +549,7 @@ public:
 			if (flags[SKIPPED_INSERT] || flags[SKIPPED_CF]) {
 				// An insert skipped because of redundancy would not
 				// be a miss. 
-				counters["wa_skip_misses"].increment(osize); 
+				counters[C_WA_SKIP_MISSES].increment(osize); 
 				
 				if (flags[SKIPPED_CF]) {
 					// The INSERT bit MUST be set, else something went wrong, 
@@ -190,7 +562,7 @@ public:
 				// This was a capacity miss---we evicted it because there was 
 				// no space for it. 
 				assert(flags[INSERTED]); 
-				counters["capacity_misses"].increment(osize);
+				counters[C_CAPACITY_MISSES].increment(osize);
 			}
 		}
 		*/
@@ -201,20 +573,38 @@ public:
 	// happens if the inserts are generated ahead of time). 
 	// Evict-pending objects that get re-inserted are counted as algorithm inserts
 	// (was_inserted) AND as a redundant insert
-	void on_insert_attempt(okey_t key, osize_t osize, 
-			bool was_inserted) {
+	void on_insert_attempt(key_type key, osize_t osize, 
+			bool was_inserted, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_INSERT_ATTEMPT);
+		log_event(was_inserted ? EV_INSERT : EV_SKIPPED_INSERT, key, osize, tenant);
 
 		if (was_inserted) {
 			// ...and we actually inserted it... 
-			counters["flash_inserts"].increment(osize);
-
-			if (record_segment_byte_breakdown) {
-				auto ret = seen.insert(key);
+			counters[C_FLASH_INSERTS].increment(osize);
+			record_partitions(P_INSERTS, tenant, osize);
+			if (recent_wa.enabled()) {
+				recent_wa.den += osize;
+			}
 
-				// If insertion into set fails, we've seen and inserted
-				// this already. If it passes, we have NOT seen this; it's a new insert.
-				if (!ret.second) {
-					counters["reinserts"].increment(osize); 
+			if constexpr (Features::per_key_tracking) {
+				insert_times[key] = (uint32_t)requests;
+				if (skipped_insert_analysis.enabled()) {
+					skipped_insert_analysis.on_written(key);
+				}
+				if (pruned_copyfwd_analysis.enabled()) {
+					pruned_copyfwd_analysis.on_written(key);
+				}
+				if (write_hitters.enabled()) {
+					write_hitters.update(key, osize);
+				}
+				if (recording_breakdown()) {
+					auto ret = seen.insert(key);
+
+					// If insertion into set fails, we've seen and inserted
+					// this already. If it passes, we have NOT seen this; it's a new insert.
+					if (!ret.second) {
+						counters[C_REINSERTS].increment(osize); 
+					}
 				}
 			}
 			
@@ -228,30 +618,62 @@ public:
 			/*
 			cached[key].set(SKIPPED_INSERT);
 			*/
-			counters["skipped_inserts"].increment(osize);
+			counters[C_SKIPPED_INSERTS].increment(osize);
+			record_partitions(P_SKIPPED_INSERTS, tenant, osize);
+			if constexpr (Features::per_key_tracking) {
+				if (skipped_insert_analysis.enabled()) {
+					skipped_insert_analysis.on_decision(key, osize, 
+							(uint32_t)requests);
+				}
+			}
 		}
 	}
 
 	// skipped_copyfwd is for copy-forwards that got pruned
-	void on_copyfwd_attempt(okey_t key, osize_t osize, 
-			bool was_copied_forward) {
+	void on_copyfwd_attempt(key_type key, osize_t osize, 
+			bool was_copied_forward, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_COPYFWD_ATTEMPT);
+		log_event(was_copied_forward ? EV_COPYFWD : EV_SKIPPED_COPYFWD, key, osize, 
+				tenant);
 		if (!was_copied_forward) {
 			/*
 			cached[key].set(SKIPPED_CF);
 			*/
-			counters["skipped_copyfwds"].increment(osize);
+			counters[C_SKIPPED_COPYFWDS].increment(osize);
+			record_partitions(P_SKIPPED_COPYFWDS, tenant, osize);
+			if constexpr (Features::per_key_tracking) {
+				if (pruned_copyfwd_analysis.enabled()) {
+					pruned_copyfwd_analysis.on_decision(key, osize, 
+							(uint32_t)requests);
+				}
+			}
 		} else {
 			/*
 			cached[key].set(CF);
 			*/
-			counters["copy_forwards"].increment(osize); 
-			if (copyfwds[key] < 0xff) {
-				copyfwds[key]++; 
+			counters[C_COPY_FORWARDS].increment(osize); 
+			record_partitions(P_COPY_FORWARDS, tenant, osize);
+			if constexpr (Features::per_key_tracking) {
+				if (copyfwds[key] < 0xff) {
+					copyfwds[key]++; 
+				}
+				if (write_hitters.enabled()) {
+					write_hitters.update(key, osize);
+				}
+			}
+		}
+		// The old copy leaves with its container either way; if it was 
+		// pruned, on_erase() follows
+		if constexpr (Features::container_stats) {
+			if (was_copied_forward) {
+				space.on_remove(osize);
 			}
 		}
 	}
 
-	void on_erase(okey_t key, osize_t osize) {
+	void on_erase(key_type key, osize_t osize) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_ERASE);
+		log_event(EV_ERASE, key, osize, 0);
 		/*
 		auto it = cached.find(key); 
 		assert(it != cached.end()); 
@@ -261,7 +683,7 @@ public:
 	   	assert(it->second[INSERTED]); 
 
 		if (!it->second[READ]) {
-			counters["one_hit_misses"].increment(osize); 
+			counters[C_ONE_HIT_MISSES].increment(osize); 
 		}
 
 		uint8_t mask = (1 << CF | 1 << READ);
@@ -269,52 +691,189 @@ public:
 		*/
 
 		// Record the copyforward info for this object and erase
-		copyfwd_hist[copyfwds[key]]++; 
-		copyfwds.erase(key);  
+		if constexpr (Features::per_key_tracking) {
+			if constexpr (Features::histograms) {
+				copyfwd_hist[copyfwds[key]]++; 
+			}
+			copyfwds.erase(key);  
+		}
+		record_eviction(key, osize);
+		if constexpr (Features::container_stats) {
+			space.on_remove(osize);
+		}
 	}
 
 	void on_container_erase() {
+		log_event(EV_CONTAINER_ERASE, 0, 0, 0);
+		containers_erased++;
+	}
+
+	// As above, for a simulator that knows which container it erased and how
+	// many of its container_bytes were still live (copied forward or not). 
+	void on_container_erase(container_t container_id, size_t live_bytes, 
+			size_t container_bytes) {
+		log_event(EV_CONTAINER_ERASE, container_id, live_bytes, 0);
 		containers_erased++;
+		if constexpr (Features::container_stats) {
+			gc_stats.on_container_erase(container_id, live_bytes, 
+					container_bytes);
+			space.on_container_erase(container_id, live_bytes, 
+					container_bytes);
+			if (ftl.enabled()) {
+				ftl.on_container_erase(container_id);
+			}
+			if (zns.enabled()) {
+				zns.on_container_erase(container_id);
+			}
+		}
 	}
 
-	void on_access(osize_t osize) {
-		counters["total_reads"].increment(osize);
+	void on_access(osize_t osize, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_ACCESS);
+		log_event(EV_ACCESS, 0, osize, tenant);
+		requests++;
+		if (recent_wa.enabled()) {
+			recent_wa.step();
+		}
+		counters[C_TOTAL_READS].increment(osize);
+		record_partitions(P_READS, tenant, osize);
 	}
 
-	void on_hit(okey_t key, osize_t osize) {
-		counters["total_hits"].increment(osize);
+	void on_hit(key_type key, osize_t osize, tenant_t tenant = 0) {
+		ProfileScope<Features::profiling> scope(profile, PROF_ON_HIT);
+		log_event(EV_HIT, key, osize, tenant);
+		counters[C_TOTAL_HITS].increment(osize);
+		record_partitions(P_HITS, tenant, osize);
 
 		/*
 		if (cached[key][CF]) {
-			counters["copyfwd_hits"].increment(osize);
+			counters[C_COPYFWD_HITS].increment(osize);
 		}
 
 		cached[key].set(READ);
 		*/
 	}
 
-	void on_evict([[maybe_unused]] okey_t key, 
-			[[maybe_unused]] osize_t osize) {
+	// An object evicted by the caching algorithm before its container is 
+	// erased. Its bytes stay on flash (as invalid) until the container is 
+	// erased. 
+	void on_evict(key_type key, osize_t osize) {
+		log_event(EV_EVICT, key, osize, 0);
+		record_eviction(key, osize);
+		if constexpr (Features::container_stats) {
+			space.on_invalidate(osize);
+		}
+	}
+
+	// An object overwritten or deleted before its container is erased; not 
+	// an eviction. Its bytes stay on flash (as invalid) as above. 
+	void on_invalidate(key_type key, osize_t osize) {
+		log_event(EV_INVALIDATE, key, osize, 0);
+		counters[C_INVALIDATIONS].increment(osize);
+		if constexpr (Features::per_key_tracking) {
+			insert_times.erase(key);
+		}
+		if constexpr (Features::container_stats) {
+			space.on_invalidate(osize);
+		}
+	}
+
+	// Count an eviction (on_erase or on_evict) and its age since insert
+	void record_eviction(key_type key, osize_t osize) {
+		counters[C_EVICTIONS].increment(osize);
+		if constexpr (Features::per_key_tracking) {
+			uint32_t *inserted = insert_times.find(key);
+			if (inserted) {
+				if constexpr (Features::histograms) {
+					eviction_age_hist.add((uint32_t)requests - *inserted);
+				}
+				insert_times.erase(key);
+			}
+			if (ghost.enabled()) {
+				ghost.record(key, (uint32_t)requests);
+			}
+		}
+	}
+
+	// As on_hit() above, for a hit served from set `set`
+	void on_hit(key_type key, osize_t osize, tenant_t tenant, set_t set) {
+		on_hit(key, osize, tenant);
+		log_event(EV_SET_HIT, set, osize, tenant);
+		if constexpr (Features::container_stats) {
+			if (set_stats.enabled()) {
+				set_stats.on_hit(set);
+			}
+		}
 	}
 
 	// I.e., what is written to the medium. 
 	// osize is object bytes written, while total_size is the full size of the 
 	// write to flash. 
-	void on_write(osize_t osize) {
-		counters["objects_written"].increment(osize); 
+	void on_write(osize_t osize, tenant_t tenant = 0) {
+		log_event(EV_WRITE, 0, osize, tenant);
+		counters[C_OBJECTS_WRITTEN].increment(osize); 
 		flash_bytes_written += osize;
+		record_partitions(P_OBJECTS_WRITTEN, tenant, osize);
+		update_ewma_written(osize);
+		if constexpr (Features::container_stats) {
+			space.on_write(osize);
+		}
+	}
+
+	// As on_write() above, for an object whose insert rewrote set `set`
+	void on_write(osize_t osize, tenant_t tenant, set_t set) {
+		on_write(osize, tenant);
+		log_event(EV_SET_WRITE, set, osize, tenant);
+		if constexpr (Features::container_stats) {
+			if (set_stats.enabled()) {
+				set_stats.on_write(set, osize);
+			}
+		}
+	}
+
+	// Occupied bytes of set `set`, after a rewrite or eviction
+	void on_set_fill(set_t set, size_t bytes) {
+		log_event(EV_SET_FILL, set, bytes, 0);
+		if constexpr (Features::container_stats) {
+			if (set_stats.enabled()) {
+				set_stats.on_fill(set, bytes);
+			}
+		}
 	}
 
 	// I.e., when container is closed or flushed to DRAM
 	void on_container_flush(size_t unused_capacity) {
+		log_event(EV_CONTAINER_FLUSH, 0, unused_capacity, 0);
 		flash_bytes_written += unused_capacity;
 		containers_written++;
+		update_ewma_written(unused_capacity);
+		if constexpr (Features::container_stats) {
+			space.on_container_flush(unused_capacity);
+		}
+	}
+
+	// As above, naming the container that was programmed
+	void on_container_flush(container_t container_id, size_t unused_capacity) {
+		on_container_flush(unused_capacity);
+		if constexpr (Features::container_stats) {
+			space.set_container_padding(container_id, unused_capacity);
+			if (endurance.enabled()) {
+				endurance.on_program(container_id);
+			}
+			if (ftl.enabled()) {
+				ftl.on_container_flush(container_id);
+			}
+			if (zns.enabled()) {
+				zns.on_container_flush(container_id, unused_capacity);
+			}
+		}
 	}
 
 	std::string dump_counters_as_json() {
 		std::string str = "{\n";
 		
-		for (auto it : counters) {
+		str += counters.to_json(); 
+		for (auto it : custom_counters) {
 			str += "\"" + it.first + "\": \n"; 
 			str += it.second.to_json(); 
 			str += ",\n"; 
@@ -323,17 +882,64 @@ public:
 		str += "\"containers_erased\": " + std::to_string(containers_erased) + ",\n"; 
 		str += "\"containers_written\": " + std::to_string(containers_written) + ",\n"; 
 
-		str += "\"copyfwd_hist\": ["; 
-		for (size_t i = 0; i < copyfwd_hist.size() - 1; ++i) {
-			str += std::to_string(copyfwd_hist[i]) + ", "; 
+		if constexpr (Features::histograms) {
+			str += "\"copyfwd_hist\": ["; 
+			for (size_t i = 0; i < copyfwd_hist.size() - 1; ++i) {
+				str += std::to_string(copyfwd_hist[i]) + ", "; 
+			}
+			str += std::to_string(copyfwd_hist[copyfwd_hist.size() - 1]) + "],\n"; 
+			str += eviction_age_hist.to_json("eviction_age_hist") + ",\n"; 
 		}
-		str += std::to_string(copyfwd_hist[copyfwd_hist.size() - 1]) + "],\n"; 
 
 		str += "\"segment_period\": " + std::to_string(inst_stats_period) + ",\n"; 
 
+		if (tenant_stats.enabled()) {
+			str += tenant_stats.to_json("tenants") + ",\n"; 
+		}
+		if (size_class_stats.enabled()) {
+			str += size_classes.to_json("size_class_bounds") + ",\n"; 
+			str += size_class_stats.to_json("size_classes") + ",\n"; 
+		}
+		if (miss_hitters.enabled()) {
+			str += miss_hitters.to_json("miss_heavy_hitters") + ",\n"; 
+			str += write_hitters.to_json("write_heavy_hitters") + ",\n"; 
+		}
+		if (skipped_insert_analysis.enabled()) {
+			str += skipped_insert_analysis.to_json("skipped_insert_analysis") + ",\n"; 
+		}
+		if (pruned_copyfwd_analysis.enabled()) {
+			str += pruned_copyfwd_analysis.to_json("pruned_copyfwd_analysis") + ",\n"; 
+		}
+		if constexpr (Features::container_stats) {
+			str += gc_stats.to_json("gc") + ",\n"; 
+			str += space.to_json("space") + ",\n"; 
+			if (set_stats.enabled()) {
+				str += set_stats.to_json("sets") + ",\n"; 
+			}
+			if (endurance.enabled()) {
+				str += endurance.to_json("endurance", flash_bytes_written, 
+						elapsed_days()) + ",\n"; 
+			}
+			if (ftl.enabled()) {
+				str += ftl.to_json("ftl", 
+						counters[C_FLASH_INSERTS].byte_counter) + ",\n"; 
+			}
+			if (zns.enabled()) {
+				str += zns.to_json("zns", elapsed_days() * 86400) + ",\n"; 
+			}
+		}
+		if constexpr (Features::profiling) {
+			str += profile.to_json("callback_profile") + ",\n"; 
+		}
+
 		str += print_segment_data(segment_util, "segment_util") + ",\n"; 
 		str += print_segment_data(segment_fbw, "segment_fbw") + ",\n"; 
-		if (record_segment_byte_breakdown) {
+		str += print_segment_data(segment_evicted_bytes, "segment_evicted_bytes") + ",\n"; 
+		str += print_segment_data(segment_evicted_objects, "segment_evicted_objects") + ",\n"; 
+		if (ghost.enabled()) {
+			str += print_segment_data(segment_bad_choice_misses, "segment_bad_choice_misses") + ",\n"; 
+		}
+		if (recording_breakdown()) {
 			str += print_segment_data(segment_copyforwards, "segment_copyforwards") + ",\n"; 
 			str += print_segment_data(segment_objectswritten, "segment_objectswritten") + ",\n"; 
 			str += print_segment_data(segment_reinserts, "segment_reinserts") + ",\n"; 
@@ -346,7 +952,13 @@ public:
 
 	void increment_custom_counter(std::string counter_name, size_t size)
 	{
-		counters[counter_name].increment(size);
+		size_t id = counters.find(counter_name);
+		if (id < NUM_COUNTERS) {
+			counters.show(id);
+			counters[id].increment(size);
+		} else {
+			custom_counters[counter_name].increment(size);
+		}
 	}
 
 	// From https://stackoverflow.com/questions/7616511/calculate-mean-and-standard-deviation-from-a-vector-of-samples-in-c-using-boos
@@ -364,4 +976,6 @@ public:
 	}
 };
 
+typedef FlashStatsT<> FlashStats;
+
 #endif  // FLASH_STATS_H
@@ -0,0 +1,119 @@
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include "common.h"
+
+/*
+ * Open-addressing hash map from integer keys to small trivially copyable
+ * values, for per-key state on the hot path. Slots live in one flat array
+ * (linear probing, backward-shift deletion, so no tombstones), which avoids
+ * the per-entry allocation and pointer chasing of std::unordered_map. The
+ * table doubles when it is 3/4 full and never shrinks.
+ */
+template <typename K, typename V>
+class FlatMap {
+public:
+	struct Slot {
+		K key;
+		V value;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint8_t> used;
+	size_t mask = 0;
+	size_t count = 0;
+
+	FlatMap(size_t capacity = 16) {
+		size_t n = 16;
+		while (n < capacity * 4 / 3 + 1) {
+			n <<= 1;
+		}
+		slots.resize(n);
+		used.assign(n, 0);
+		mask = n - 1;
+	}
+
+	static size_t hash(K key) {
+		uint64_t h = (uint64_t)key * 0x9e3779b97f4a7c15ull;
+		return h ^ (h >> 32);
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	V *find(K key) {
+		for (size_t i = hash(key) & mask; used[i]; i = (i + 1) & mask) {
+			if (slots[i].key == key) {
+				return &slots[i].value;
+			}
+		}
+		return nullptr;
+	}
+
+	// Value for key, value-initialized if it was not present
+	V &operator[](K key) {
+		if ((count + 1) * 4 > slots.size() * 3) {
+			grow();
+		}
+		size_t i = hash(key) & mask;
+		for (; used[i]; i = (i + 1) & mask) {
+			if (slots[i].key == key) {
+				return slots[i].value;
+			}
+		}
+		used[i] = 1;
+		slots[i] = {key, V()};
+		count++;
+		return slots[i].value;
+	}
+
+	bool erase(K key) {
+		size_t i = hash(key) & mask;
+		for (; used[i]; i = (i + 1) & mask) {
+			if (slots[i].key == key) {
+				break;
+			}
+		}
+		if (!used[i]) {
+			return false;
+		}
+
+		// Shift back later entries of the probe run that may not sit in
+		// front of their home slot
+		size_t j = i;
+		while (true) {
+			j = (j + 1) & mask;
+			if (!used[j]) {
+				break;
+			}
+			size_t home = hash(slots[j].key) & mask;
+			if (((j - home) & mask) >= ((j - i) & mask)) {
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+		used[i] = 0;
+		count--;
+		return true;
+	}
+
+	void grow() {
+		std::vector<Slot> old_slots;
+		std::vector<uint8_t> old_used;
+		old_slots.swap(slots);
+		old_used.swap(used);
+
+		slots.resize(old_slots.size() * 2);
+		used.assign(slots.size(), 0);
+		mask = slots.size() - 1;
+		count = 0;
+		for (size_t i = 0; i < old_slots.size(); ++i) {
+			if (old_used[i]) {
+				(*this)[old_slots[i].key] = old_slots[i].value;
+			}
+		}
+	}
+};
+
+#endif  // FLAT_MAP_H
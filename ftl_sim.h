@@ -0,0 +1,365 @@
+#ifndef FTL_SIM_H
+#define FTL_SIM_H
+
+#include "common.h"
+#include "gc_stats.h"
+
+#include <cmath>
+#include <stdexcept>
+
+enum FtlGcPolicy {
+	FTL_GC_GREEDY,        // fewest valid pages
+	FTL_GC_COST_BENEFIT,  // max (1 - u) * age / 2u, as in LFS
+};
+
+struct FtlConfig {
+	size_t device_bytes = 0;     // logical (exported) capacity
+	size_t container_bytes = 0;  // host write unit; container i is at LBA i
+	size_t page_bytes = 4096;
+	uint32_t pages_per_block = 256;
+	double over_provisioning = 0.07;  // spare physical space, over logical
+	FtlGcPolicy gc_policy = FTL_GC_GREEDY;
+	// Host container erases TRIM the container's LBAs
+	bool trim_on_erase = true;
+	// GC runs before a host write opens a new block, until more than this 
+	// many blocks are free
+	uint32_t gc_free_blocks = 2;
+	// Cost-benefit scores this many randomly sampled closed blocks (plus 
+	// the emptiest one) per victim instead of every block
+	uint32_t cost_benefit_samples = 64;
+};
+
+/*
+ * Page-mapped FTL underneath the host's containers, for device-level write
+ * amplification. The host writes container i over logical pages
+ * [i * pages_per_container, (i + 1) * pages_per_container); each page goes
+ * to the next free physical page, invalidating the old mapping, and GC
+ * relocates the valid pages of a victim block before erasing it.
+ *
+ * State is flat arrays indexed by page or block number plus a valid-page
+ * bitmap, so per-page work is a few array updates. Closed blocks also sit in
+ * intrusive lists bucketed by valid-page count, so greedy GC takes its victim
+ * from the lowest non-empty bucket in O(1) amortized, and cost-benefit scores
+ * a bounded random sample of closed blocks rather than the whole device.
+ *
+ * Device WA is (host + GC page writes)/host page writes; total WA is device
+ * bytes written over application bytes inserted.
+ */
+class FtlSim {
+public:
+	static constexpr uint32_t NO_PAGE = UINT32_MAX;
+	enum BlockState : uint8_t {
+		B_FREE,
+		B_OPEN,
+		B_CLOSED,
+	};
+
+	FtlConfig config;
+	uint32_t pages_per_container = 0;
+	size_t logical_pages = 0;
+	size_t num_blocks = 0;
+
+	std::vector<uint32_t> l2p;
+	std::vector<uint32_t> p2l;
+	std::vector<uint64_t> valid;
+	std::vector<uint32_t> block_valid;
+	std::vector<uint64_t> block_closed_at;  // write_seq when filled
+	std::vector<uint8_t> block_state;
+	std::vector<uint32_t> free_blocks;
+	// Closed blocks by valid-page count, oldest first: bucket_head[v] and 
+	// bucket_tail[v] end a list linked through block_next/block_prev
+	std::vector<uint32_t> bucket_head;
+	std::vector<uint32_t> bucket_tail;
+	std::vector<uint32_t> block_next;
+	std::vector<uint32_t> block_prev;
+	uint32_t min_bucket = 0;  // no non-empty bucket below this
+	uint64_t rng = 0x9e3779b97f4a7c15ull;
+	uint32_t open_block = 0;
+	uint32_t open_offset = 0;
+
+	uint64_t write_seq = 0;
+	uint64_t host_pages = 0;
+	uint64_t gc_pages = 0;
+	uint64_t trimmed_pages = 0;
+	uint64_t block_erases = 0;
+
+	uint64_t last_host_pages = 0;
+	uint64_t last_gc_pages = 0;
+	uint64_t last_app_bytes = 0;
+	std::vector<size_t> segment_host_pages;
+	std::vector<size_t> segment_gc_pages;
+	std::vector<size_t> segment_app_bytes;
+
+	FtlSim() {}
+
+	FtlSim(FtlConfig c)
+		: config(c) {
+		if (!config.device_bytes || !config.container_bytes || 
+				!config.page_bytes || !config.pages_per_block) {
+			throw std::invalid_argument("FTL needs device, container, page "
+					"and block sizes");
+		}
+		if (config.over_provisioning <= 0) {
+			throw std::invalid_argument("FTL needs some over-provisioning");
+		}
+		pages_per_container = 
+			(config.container_bytes + config.page_bytes - 1)/config.page_bytes;
+		logical_pages = config.device_bytes/config.page_bytes;
+		size_t ppb = config.pages_per_block;
+		size_t physical = logical_pages * (1 + config.over_provisioning);
+		num_blocks = std::max((physical + ppb - 1)/ppb, 
+				(logical_pages + ppb - 1)/ppb + config.gc_free_blocks + 1);
+
+		l2p.assign(logical_pages, NO_PAGE);
+		p2l.assign(num_blocks * ppb, NO_PAGE);
+		valid.assign((num_blocks * ppb + 63)/64, 0);
+		block_valid.assign(num_blocks, 0);
+		block_closed_at.assign(num_blocks, 0);
+		block_state.assign(num_blocks, B_FREE);
+		bucket_head.assign(ppb + 1, NO_PAGE);
+		bucket_tail.assign(ppb + 1, NO_PAGE);
+		block_next.assign(num_blocks, NO_PAGE);
+		block_prev.assign(num_blocks, NO_PAGE);
+		min_bucket = ppb + 1;
+		for (size_t b = num_blocks - 1; b > 0; --b) {
+			free_blocks.push_back(b);
+		}
+		open_block = 0;
+		block_state[0] = B_OPEN;
+	}
+
+	bool enabled() const {
+		return num_blocks != 0;
+	}
+
+	bool is_valid(uint32_t ppn) const {
+		return valid[ppn >> 6] >> (ppn & 63) & 1;
+	}
+
+	// Blocks enter a bucket in order of closing (or of their last
+	// invalidation), so greedy ties go to the block left alone longest
+	void bucket_insert(uint32_t b) {
+		uint32_t v = block_valid[b];
+		block_next[b] = NO_PAGE;
+		block_prev[b] = bucket_tail[v];
+		if (bucket_tail[v] != NO_PAGE) {
+			block_next[bucket_tail[v]] = b;
+		} else {
+			bucket_head[v] = b;
+		}
+		bucket_tail[v] = b;
+		min_bucket = std::min(min_bucket, v);
+	}
+
+	void bucket_remove(uint32_t b) {
+		uint32_t v = block_valid[b];
+		if (block_prev[b] == NO_PAGE) {
+			bucket_head[v] = block_next[b];
+		} else {
+			block_next[block_prev[b]] = block_next[b];
+		}
+		if (block_next[b] != NO_PAGE) {
+			block_prev[block_next[b]] = block_prev[b];
+		} else {
+			bucket_tail[v] = block_prev[b];
+		}
+	}
+
+	void invalidate(uint32_t lpn) {
+		uint32_t ppn = l2p[lpn];
+		if (ppn == NO_PAGE) {
+			return;
+		}
+		valid[ppn >> 6] &= ~((uint64_t)1 << (ppn & 63));
+		uint32_t b = ppn / config.pages_per_block;
+		if (block_state[b] == B_CLOSED) {
+			bucket_remove(b);
+			block_valid[b]--;
+			bucket_insert(b);
+		} else {
+			block_valid[b]--;
+		}
+		l2p[lpn] = NO_PAGE;
+	}
+
+	// Append one page at the write frontier
+	void program(uint32_t lpn) {
+		if (open_offset == config.pages_per_block) {
+			block_state[open_block] = B_CLOSED;
+			block_closed_at[open_block] = write_seq;
+			bucket_insert(open_block);
+			if (free_blocks.empty()) {
+				throw std::runtime_error("FTL out of free blocks");
+			}
+			open_block = free_blocks.back();
+			free_blocks.pop_back();
+			block_state[open_block] = B_OPEN;
+			open_offset = 0;
+		}
+		uint32_t ppn = open_block * config.pages_per_block + open_offset++;
+		l2p[lpn] = ppn;
+		p2l[ppn] = lpn;
+		valid[ppn >> 6] |= (uint64_t)1 << (ppn & 63);
+		block_valid[open_block]++;
+		write_seq++;
+	}
+
+	// Closed block with the fewest valid pages
+	uint32_t emptiest() {
+		while (min_bucket <= config.pages_per_block && 
+				bucket_head[min_bucket] == NO_PAGE) {
+			min_bucket++;
+		}
+		return min_bucket <= config.pages_per_block ? 
+			bucket_head[min_bucket] : NO_PAGE;
+	}
+
+	double cost_benefit(uint32_t b) const {
+		double u = (double)block_valid[b]/config.pages_per_block;
+		double age = write_seq - block_closed_at[b] + 1;
+		return u > 0 ? (1 - u) * age/(2 * u) : HUGE_VAL;
+	}
+
+	uint32_t random_block() {
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		return rng % num_blocks;
+	}
+
+	uint32_t pick_victim() {
+		uint32_t victim = emptiest();
+		if (victim == NO_PAGE || config.gc_policy == FTL_GC_GREEDY) {
+			return victim;
+		}
+		double best = cost_benefit(victim);
+		uint32_t sampled = 0;
+		for (uint32_t tries = 0; sampled < config.cost_benefit_samples && 
+				tries < 4 * config.cost_benefit_samples; ++tries) {
+			uint32_t b = random_block();
+			if (block_state[b] != B_CLOSED) {
+				continue;
+			}
+			sampled++;
+			double score = cost_benefit(b);
+			if (score > best) {
+				best = score;
+				victim = b;
+			}
+		}
+		return victim;
+	}
+
+	void collect_garbage() {
+		while (free_blocks.size() <= config.gc_free_blocks) {
+			uint32_t victim = pick_victim();
+			if (victim == NO_PAGE || 
+					block_valid[victim] == config.pages_per_block) {
+				return;  // nothing reclaimable
+			}
+			bucket_remove(victim);
+			block_state[victim] = B_FREE;
+			uint32_t first = victim * config.pages_per_block;
+			for (uint32_t p = first; p < first + config.pages_per_block; ++p) {
+				if (is_valid(p)) {
+					uint32_t lpn = p2l[p];
+					invalidate(lpn);
+					program(lpn);
+					gc_pages++;
+				}
+			}
+			block_erases++;
+			free_blocks.push_back(victim);
+		}
+	}
+
+	void write_page(uint32_t lpn) {
+		if (open_offset == config.pages_per_block && 
+				free_blocks.size() <= config.gc_free_blocks) {
+			collect_garbage();
+		}
+		invalidate(lpn);
+		program(lpn);
+		host_pages++;
+	}
+
+	void on_container_flush(container_t id) {
+		size_t first = (size_t)id * pages_per_container;
+		size_t last = std::min(first + pages_per_container, logical_pages);
+		for (size_t lpn = first; lpn < last; ++lpn) {
+			write_page(lpn);
+		}
+	}
+
+	void on_container_erase(container_t id) {
+		if (!config.trim_on_erase) {
+			return;
+		}
+		size_t first = (size_t)id * pages_per_container;
+		size_t last = std::min(first + pages_per_container, logical_pages);
+		for (size_t lpn = first; lpn < last; ++lpn) {
+			if (l2p[lpn] != NO_PAGE) {
+				invalidate(lpn);
+				trimmed_pages++;
+			}
+		}
+	}
+
+	static double ratio(uint64_t num, uint64_t den) {
+		return den ? (double)num/den : 0;
+	}
+
+	double device_wa() const {
+		return ratio(host_pages + gc_pages, host_pages);
+	}
+
+	// inserted_bytes: application bytes inserted so far
+	double total_wa(uint64_t inserted_bytes) const {
+		return ratio((host_pages + gc_pages) * config.page_bytes, 
+				inserted_bytes);
+	}
+
+	void collect_periodic_stats(uint64_t inserted_bytes) {
+		segment_host_pages.push_back(host_pages - last_host_pages);
+		last_host_pages = host_pages;
+		segment_gc_pages.push_back(gc_pages - last_gc_pages);
+		last_gc_pages = gc_pages;
+		segment_app_bytes.push_back(inserted_bytes - last_app_bytes);
+		last_app_bytes = inserted_bytes;
+	}
+
+	std::string to_json(std::string name, uint64_t inserted_bytes) {
+		std::vector<double> seg_device_wa(segment_host_pages.size());
+		std::vector<double> seg_total_wa(segment_host_pages.size());
+		for (size_t i = 0; i < segment_host_pages.size(); ++i) {
+			uint64_t written = segment_host_pages[i] + segment_gc_pages[i];
+			seg_device_wa[i] = ratio(written, segment_host_pages[i]);
+			seg_total_wa[i] = ratio(written * config.page_bytes, 
+					segment_app_bytes[i]);
+		}
+
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"gc_policy\": \"" + std::string(config.gc_policy == 
+				FTL_GC_GREEDY ? "greedy" : "cost_benefit") + "\",\n";
+		str += "\"over_provisioning\": " + 
+			std::to_string(config.over_provisioning) + ",\n";
+		str += "\"page_bytes\": " + std::to_string(config.page_bytes) + ",\n";
+		str += "\"pages_per_block\": " + 
+			std::to_string(config.pages_per_block) + ",\n";
+		str += "\"blocks\": " + std::to_string(num_blocks) + ",\n";
+		str += "\"host_pages\": " + std::to_string(host_pages) + ",\n";
+		str += "\"gc_pages\": " + std::to_string(gc_pages) + ",\n";
+		str += "\"trimmed_pages\": " + std::to_string(trimmed_pages) + ",\n";
+		str += "\"block_erases\": " + std::to_string(block_erases) + ",\n";
+		str += "\"device_wa\": " + std::to_string(device_wa()) + ",\n";
+		str += "\"total_wa\": " + std::to_string(total_wa(inserted_bytes)) + ",\n";
+		str += print_segment_data(segment_host_pages, "segment_host_pages") + ",\n";
+		str += print_segment_data(segment_gc_pages, "segment_gc_pages") + ",\n";
+		str += print_segment_data(seg_device_wa, "segment_device_wa") + ",\n";
+		str += print_segment_data(seg_total_wa, "segment_total_wa") + "\n";
+		str += "}";
+		return str;
+	}
+};
+
+#endif  // FTL_SIM_H
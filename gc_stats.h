@@ -0,0 +1,99 @@
+#ifndef GC_STATS_H
+#define GC_STATS_H
+
+#include "common.h"
+
+#include <algorithm>
+
+typedef uint32_t container_t;
+
+/*
+ * Garbage-collection efficiency, from the live data left in each container
+ * when it is erased. Live bytes are whatever the cache still considered valid
+ * at erase time, whether it was then copied forward or dropped, so they are
+ * the cost of the victim choice: a perfect victim is entirely dead.
+ *
+ * "valid_fraction_hist": victims by live/container bytes, in NUM_BUCKETS
+ * 	equal-width buckets (a fully live victim lands in the last one)
+ * "container_erases": erase count per container ID
+ * GC efficiency of a segment is the fraction of the erased container bytes
+ * that were reclaimed, i.e. 1 - live/erased; 0 if nothing was erased.
+ */
+class GcStats {
+public:
+	static const size_t NUM_BUCKETS = 20;
+
+	uint64_t valid_fraction_hist[NUM_BUCKETS] = {};
+	std::vector<uint32_t> container_erases;
+
+	uint64_t live_bytes = 0;
+	uint64_t erased_bytes = 0;
+
+	uint64_t last_live_bytes = 0;
+	uint64_t last_erased_bytes = 0;
+	std::vector<size_t> segment_live_bytes;
+	std::vector<size_t> segment_erased_bytes;
+
+	void on_container_erase(container_t id, size_t live, size_t capacity) {
+		if (id >= container_erases.size()) {
+			container_erases.resize((size_t)id + 1, 0);
+		}
+		container_erases[id]++;
+
+		live = std::min(live, capacity);
+		size_t bucket = capacity ? live * NUM_BUCKETS / capacity : 0;
+		valid_fraction_hist[std::min(bucket, NUM_BUCKETS - 1)]++;
+
+		live_bytes += live;
+		erased_bytes += capacity;
+	}
+
+	double efficiency() const {
+		return erased_bytes ? 1 - (double)live_bytes/erased_bytes : 0;
+	}
+
+	void collect_periodic_stats() {
+		segment_live_bytes.push_back(live_bytes - last_live_bytes);
+		last_live_bytes = live_bytes;
+		segment_erased_bytes.push_back(erased_bytes - last_erased_bytes);
+		last_erased_bytes = erased_bytes;
+	}
+
+	std::vector<double> segment_efficiency() const {
+		std::vector<double> eff(segment_erased_bytes.size(), 0);
+		for (size_t i = 0; i < eff.size(); ++i) {
+			if (segment_erased_bytes[i]) {
+				eff[i] = 1 - (double)segment_live_bytes[i]/segment_erased_bytes[i];
+			}
+		}
+		return eff;
+	}
+
+	std::string to_json(std::string name) {
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"live_bytes\": " + std::to_string(live_bytes) + ",\n";
+		str += "\"erased_bytes\": " + std::to_string(erased_bytes) + ",\n";
+		str += "\"efficiency\": " + std::to_string(efficiency()) + ",\n";
+
+		str += "\"valid_fraction_hist\": [";
+		for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+			str += std::to_string(valid_fraction_hist[i]);
+			str += (i + 1 < NUM_BUCKETS) ? ", " : "],\n";
+		}
+
+		str += "\"container_erases\": [";
+		for (size_t i = 0; i < container_erases.size(); ++i) {
+			str += std::to_string(container_erases[i]);
+			str += (i + 1 < container_erases.size()) ? ", " : "";
+		}
+		str += "],\n";
+
+		str += print_segment_data(segment_live_bytes, "segment_live_bytes") + ",\n";
+		str += print_segment_data(segment_erased_bytes, "segment_erased_bytes") + ",\n";
+		str += print_segment_data(segment_efficiency(), "segment_efficiency") + "\n";
+		str += "}";
+		return str;
+	}
+};
+
+#endif  // GC_STATS_H
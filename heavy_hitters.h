@@ -0,0 +1,164 @@
+#ifndef HEAVY_HITTERS_H
+#define HEAVY_HITTERS_H
+
+#include "common.h"
+#include "flat_map.h"
+
+#include <algorithm>
+
+/*
+ * Weighted Space-Saving: approximate top keys by total weight (e.g. bytes)
+ * in a fixed number of counters. A key without a counter takes over the
+ * smallest one, inheriting its count as an error bound, so a key's count
+ * overestimates its true weight by at most its error, and any key heavier
+ * than total/capacity is guaranteed a counter. Counters are a binary
+ * min-heap with a key -> heap position FlatMap, so an update is O(log
+ * capacity) and memory is fixed.
+ */
+template <typename K>
+class SpaceSaving {
+public:
+	struct Entry {
+		K key;
+		uint64_t count;
+		uint64_t error;
+	};
+
+	size_t capacity = 0;
+	std::vector<Entry> heap;
+	FlatMap<K, uint32_t> position;
+
+	SpaceSaving() {}
+
+	SpaceSaving(size_t counters)
+		: capacity(counters), position(counters) {
+		heap.reserve(counters);
+	}
+
+	void swap_entries(size_t a, size_t b) {
+		std::swap(heap[a], heap[b]);
+		position[heap[a].key] = a;
+		position[heap[b].key] = b;
+	}
+
+	void sift_down(size_t i) {
+		while (true) {
+			size_t smallest = i;
+			size_t l = 2 * i + 1, r = 2 * i + 2;
+			if (l < heap.size() && heap[l].count < heap[smallest].count) {
+				smallest = l;
+			}
+			if (r < heap.size() && heap[r].count < heap[smallest].count) {
+				smallest = r;
+			}
+			if (smallest == i) {
+				return;
+			}
+			swap_entries(i, smallest);
+			i = smallest;
+		}
+	}
+
+	void sift_up(size_t i) {
+		while (i > 0 && heap[i].count < heap[(i - 1)/2].count) {
+			swap_entries(i, (i - 1)/2);
+			i = (i - 1)/2;
+		}
+	}
+
+	void update(K key, uint64_t weight) {
+		uint32_t *pos = position.find(key);
+		if (pos) {
+			// Counts only grow, so the entry can only move down
+			size_t i = *pos;
+			heap[i].count += weight;
+			sift_down(i);
+		} else if (heap.size() < capacity) {
+			heap.push_back({key, weight, 0});
+			position[key] = heap.size() - 1;
+			sift_up(heap.size() - 1);
+		} else if (capacity) {
+			Entry &min = heap[0];
+			position.erase(min.key);
+			min = {key, min.count + weight, min.count};
+			position[key] = 0;
+			sift_down(0);
+		}
+	}
+
+	void clear() {
+		heap.clear();
+		position = FlatMap<K, uint32_t>(capacity);
+	}
+
+	// The k heaviest entries, heaviest first
+	std::vector<Entry> top(size_t k) const {
+		std::vector<Entry> sorted(heap);
+		k = std::min(k, sorted.size());
+		std::partial_sort(sorted.begin(), sorted.begin() + k, sorted.end(), 
+				[](Entry const &a, Entry const &b) { return a.count > b.count; });
+		sorted.resize(k);
+		return sorted;
+	}
+
+	static std::string to_json(std::vector<Entry> const &entries) {
+		std::string str = "[";
+		for (size_t i = 0; i < entries.size(); ++i) {
+			str += "{\"key\": " + std::to_string(entries[i].key) + 
+				", \"bytes\": " + std::to_string(entries[i].count) + 
+				", \"error\": " + std::to_string(entries[i].error) + "}";
+			str += (i + 1 < entries.size()) ? ", " : "";
+		}
+		return str + "]";
+	}
+};
+
+/*
+ * Top-K keys by one weight, over the whole run and per segment. The segment
+ * tracker restarts at each collect_periodic_stats(), after its top-K is
+ * saved.
+ */
+template <typename K>
+class HeavyHitters {
+public:
+	typedef typename SpaceSaving<K>::Entry Entry;
+
+	size_t top_k = 0;
+	SpaceSaving<K> overall;
+	SpaceSaving<K> segment;
+	std::vector<std::vector<Entry>> segment_top;
+
+	HeavyHitters() {}
+
+	HeavyHitters(size_t counters, size_t k)
+		: top_k(k), overall(counters), segment(counters) {
+	}
+
+	bool enabled() const {
+		return top_k != 0;
+	}
+
+	void update(K key, uint64_t weight) {
+		overall.update(key, weight);
+		segment.update(key, weight);
+	}
+
+	void collect_periodic_stats() {
+		segment_top.push_back(segment.top(top_k));
+		segment.clear();
+	}
+
+	std::string to_json(std::string name) const {
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"top\": " + SpaceSaving<K>::to_json(overall.top(top_k)) + ",\n";
+		str += "\"segment_top\": [";
+		for (size_t i = 0; i < segment_top.size(); ++i) {
+			str += SpaceSaving<K>::to_json(segment_top[i]);
+			str += (i + 1 < segment_top.size()) ? ",\n" : "";
+		}
+		str += "]\n}";
+		return str;
+	}
+};
+
+#endif  // HEAVY_HITTERS_H
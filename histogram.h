@@ -0,0 +1,38 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "common.h"
+
+/*
+ * Power-of-two bucketed histogram of 64-bit values: bucket 0 holds 0 and
+ * bucket i holds [2^(i-1), 2^i). Dumped up to the highest non-empty bucket.
+ */
+class Log2Histogram {
+public:
+	static const size_t NUM_BUCKETS = 65;
+
+	uint64_t buckets[NUM_BUCKETS] = {};
+
+	static size_t bucket(uint64_t v) {
+		return v ? 64 - __builtin_clzll(v) : 0;
+	}
+
+	void add(uint64_t v) {
+		buckets[bucket(v)]++;
+	}
+
+	std::string to_json(std::string name) const {
+		size_t n = NUM_BUCKETS;
+		while (n > 1 && !buckets[n - 1]) {
+			n--;
+		}
+		std::string str = "\"" + name + "\": [";
+		for (size_t i = 0; i < n; ++i) {
+			str += std::to_string(buckets[i]);
+			str += (i + 1 < n) ? ", " : "]";
+		}
+		return str;
+	}
+};
+
+#endif  // HISTOGRAM_H
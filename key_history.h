@@ -0,0 +1,72 @@
+#ifndef KEY_HISTORY_H
+#define KEY_HISTORY_H
+
+#include "common.h"
+#include "flat_map.h"
+
+/*
+ * Bounded FIFO of recently recorded keys, each with a 32-bit timestamp taken
+ * when it was recorded; once full, recording a key drops the oldest. Keys
+ * are kept as 32-bit fingerprints (a bijection for 32-bit keys; wider keys
+ * may rarely collide), in a ring plus a fingerprint -> position index, so
+ * memory is fixed at roughly 20 bytes per entry.
+ */
+class KeyHistory {
+public:
+	struct Entry {
+		uint32_t fingerprint;
+		uint32_t time;
+	};
+
+	std::vector<Entry> ring;
+	uint64_t recorded = 0;
+	FlatMap<uint32_t, uint64_t> index;  // fingerprint -> newest position
+
+	KeyHistory() {}
+
+	KeyHistory(size_t capacity)
+		: ring(capacity), index(capacity) {
+	}
+
+	bool enabled() const {
+		return !ring.empty();
+	}
+
+	size_t size() const {
+		return index.size();
+	}
+
+	static uint32_t fingerprint(uint64_t key) {
+		uint32_t folded = (uint32_t)(key ^ (key >> 32));
+		return folded * 0x9e3779b1u;
+	}
+
+	void record(uint64_t key, uint32_t time) {
+		size_t slot = recorded % ring.size();
+		if (recorded >= ring.size()) {
+			uint32_t oldest = ring[slot].fingerprint;
+			uint64_t *pos = index.find(oldest);
+			if (pos && *pos == recorded - ring.size()) {
+				index.erase(oldest);
+			}
+		}
+		uint32_t fp = fingerprint(key);
+		ring[slot] = {fp, time};
+		index[fp] = recorded++;
+	}
+
+	// If key is in the history, remove it and set *time to when it was
+	// recorded
+	bool remove(uint64_t key, uint32_t *time) {
+		uint32_t fp = fingerprint(key);
+		uint64_t *pos = index.find(fp);
+		if (!pos) {
+			return false;
+		}
+		*time = ring[*pos % ring.size()].time;
+		index.erase(fp);
+		return true;
+	}
+};
+
+#endif  // KEY_HISTORY_H
@@ -0,0 +1,126 @@
+#ifndef NULL_STATS_H
+#define NULL_STATS_H
+
+#include "common.h"
+#include "event_log.h"
+#include "ftl_sim.h"
+#include "gc_stats.h"
+#include "partition_stats.h"
+#include "set_stats.h"
+#include "tier_stats.h"
+#include "zns_stats.h"
+
+/*
+ * Drop-in replacements for CacheStats and FlashStats that record nothing.
+ * Every callback is an empty inline function, so a simulator templated on its
+ * stats type pays nothing for stats when instantiated with these.
+ */
+class NullCacheStats {
+public:
+	int inst_stats_period;
+
+	NullCacheStats(int m)
+		: inst_stats_period(m) {
+	}
+
+	void enable_tenant_stats(size_t) {}
+	void enable_size_class_stats(std::vector<osize_t>) {}
+	void enable_tier_stats(std::vector<std::string> = {}) {}
+	void attach_event_log(EventLog *) {}
+	void enable_shadow_lru(size_t) {}
+	void enable_frequency_sketch(size_t, uint64_t = 0) {}
+	void enable_ewma(double) {}
+
+	uint32_t frequency(uint64_t) {
+		return 0;
+	}
+
+	double current_ohr() const {
+		return 0;
+	}
+
+	double current_bhr() const {
+		return 0;
+	}
+
+	void collect_periodic_stats() {}
+	void print_periodic_stats() {}
+
+	void on_miss(osize_t, tenant_t = 0) {}
+	void on_insert_attempt(osize_t, bool, tenant_t = 0) {}
+	void on_access(osize_t, tenant_t = 0) {}
+	void on_keyed_access(uint64_t, osize_t, tenant_t = 0) {}
+	void on_invalidate(uint64_t) {}
+	void on_admission_reject(uint64_t) {}
+	void on_hit(osize_t, tenant_t = 0) {}
+	void on_dram_hit(osize_t) {}
+	void on_dram_miss(osize_t) {}
+	void on_tier_hit(tier_t, osize_t) {}
+	void on_tier_miss(tier_t, osize_t) {}
+	void on_served_from(tier_t, osize_t) {}
+
+	std::string dump_counters_as_json() {
+		return "{}";
+	}
+};
+
+class NullFlashStats {
+public:
+	// Wide enough for any key; nothing is stored
+	typedef uint64_t key_type;
+
+	int inst_stats_period;
+
+	NullFlashStats(int m, bool)
+		: inst_stats_period(m) {
+	}
+
+	void enable_tenant_stats(size_t) {}
+	void enable_size_class_stats(std::vector<osize_t>) {}
+	void attach_event_log(EventLog *) {}
+	void enable_endurance_model(size_t, size_t, uint32_t) {}
+	void enable_ghost_cache(size_t) {}
+	void enable_heavy_hitters(size_t, size_t = 10) {}
+	void enable_set_stats(size_t, size_t, size_t = 10) {}
+	void enable_admission_analysis(size_t) {}
+	void enable_copyfwd_analysis(size_t) {}
+	void enable_ftl_model(FtlConfig) {}
+	void enable_zns_mode(ZnsConfig) {}
+	void set_trace_time(otime_t) {}
+	void enable_ewma(double, double) {}
+
+	double current_write_rate() {
+		return 0;
+	}
+
+	double current_wa() const {
+		return 0;
+	}
+
+	void collect_periodic_stats(size_t) {}
+	void print_periodic_stats() {}
+
+	void on_miss(key_type, osize_t, tenant_t = 0) {}
+	void on_insert_attempt(key_type, osize_t, bool, tenant_t = 0) {}
+	void on_copyfwd_attempt(key_type, osize_t, bool, tenant_t = 0) {}
+	void on_erase(key_type, osize_t) {}
+	void on_container_erase() {}
+	void on_container_erase(container_t, size_t, size_t) {}
+	void on_access(osize_t, tenant_t = 0) {}
+	void on_hit(key_type, osize_t, tenant_t = 0) {}
+	void on_hit(key_type, osize_t, tenant_t, set_t) {}
+	void on_evict(key_type, osize_t) {}
+	void on_invalidate(key_type, osize_t) {}
+	void on_write(osize_t, tenant_t = 0) {}
+	void on_write(osize_t, tenant_t, set_t) {}
+	void on_set_fill(set_t, size_t) {}
+	void on_container_flush(size_t) {}
+	void on_container_flush(container_t, size_t) {}
+	void increment_custom_counter(std::string, size_t) {}
+
+	std::string dump_counters_as_json() {
+		return "{}";
+	}
+};
+
+#endif  // NULL_STATS_H
@@ -0,0 +1,170 @@
+#ifndef PARTITION_STATS_H
+#define PARTITION_STATS_H
+
+#include "common.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+typedef uint16_t tenant_t;
+
+/*
+ * Counters kept separately for each partition of the request stream (tenant,
+ * namespace, ...). Each counter is one contiguous array indexed by partition,
+ * so recording an event is two indexed adds with no map lookups.
+ *
+ * Counter ids are small integers chosen by the owner (an enum); names are only
+ * used when dumping. Segment series are kept per (counter, partition) and are
+ * filled by collect_periodic_stats(), same as the global segment series.
+ *
+ * Partition IDs come from the caller's trace; events with an ID outside
+ * [0, num_partitions) are dropped and counted in "out_of_range".
+ */
+class PartitionedCounters {
+public:
+	std::vector<std::string> names;
+	size_t num_partitions = 0;
+	counter_t out_of_range = 0;
+
+	// Indexed by counter * num_partitions + partition
+	std::vector<counter_t> bytes;
+	std::vector<counter_t> objects;
+
+	std::vector<counter_t> last_bytes;
+	std::vector<counter_t> last_objects;
+	std::vector<std::vector<size_t>> segment_bytes;
+	std::vector<std::vector<size_t>> segment_objects;
+
+	PartitionedCounters() {}
+
+	PartitionedCounters(std::vector<std::string> n, size_t p)
+		: names(n), num_partitions(p),
+		bytes(n.size() * p, 0), objects(n.size() * p, 0),
+		last_bytes(n.size() * p, 0), last_objects(n.size() * p, 0),
+		segment_bytes(n.size() * p), segment_objects(n.size() * p) {
+	}
+
+	bool enabled() const {
+		return num_partitions != 0;
+	}
+
+	void increment(size_t counter, size_t partition, osize_t size) {
+		if (partition >= num_partitions) {
+			out_of_range++;
+			return;
+		}
+		size_t idx = counter * num_partitions + partition;
+		bytes[idx] += size;
+		objects[idx]++;
+	}
+
+	// Sum over all partitions
+	Counter rollup(size_t counter) const {
+		Counter total;
+		for (size_t p = 0; p < num_partitions; ++p) {
+			total.byte_counter += bytes[counter * num_partitions + p];
+			total.object_counter += objects[counter * num_partitions + p];
+		}
+		return total;
+	}
+
+	void collect_periodic_stats() {
+		for (size_t i = 0; i < bytes.size(); ++i) {
+			segment_bytes[i].push_back(bytes[i] - last_bytes[i]);
+			segment_objects[i].push_back(objects[i] - last_objects[i]);
+		}
+		last_bytes = bytes;
+		last_objects = objects;
+	}
+
+	std::string to_json(std::string name) {
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"num_partitions\": " + std::to_string(num_partitions) + ",\n";
+		str += "\"out_of_range\": " + std::to_string(out_of_range) + ",\n";
+
+		for (size_t c = 0; c < names.size(); ++c) {
+			std::vector<size_t> b(bytes.begin() + c * num_partitions,
+					bytes.begin() + (c + 1) * num_partitions);
+			std::vector<size_t> o(objects.begin() + c * num_partitions,
+					objects.begin() + (c + 1) * num_partitions);
+			Counter total = rollup(c);
+
+			str += "\"" + names[c] + "\": {";
+			str += print_segment_data(b, "bytes") + ", ";
+			str += print_segment_data(o, "objects") + ", ";
+			str += "\"total_bytes\": " + std::to_string(total.byte_counter) + ", ";
+			str += "\"total_objects\": " + std::to_string(total.object_counter) + "},\n";
+		}
+
+		for (size_t c = 0; c < names.size(); ++c) {
+			str += "\"segment_" + names[c] + "\": [\n";
+			for (size_t p = 0; p < num_partitions; ++p) {
+				size_t idx = c * num_partitions + p;
+				str += "\t{" + print_segment_data(segment_bytes[idx], "bytes") + ", ";
+				str += print_segment_data(segment_objects[idx], "objects") + "}";
+				str += (p + 1 < num_partitions) ? ",\n" : "\n";
+			}
+			str += (c + 1 < names.size()) ? "],\n" : "]\n";
+		}
+
+		str += "}";
+		return str;
+	}
+};
+
+/*
+ * Maps an object size to a size class. Given ascending boundaries b_0 < b_1 <
+ * ..., class 0 holds sizes below b_0, class i sizes in [b_(i-1), b_i), and the
+ * last class everything from the last boundary up. 
+ *
+ * The boundaries live in a fixed-length array padded with the maximum size, 
+ * and the class is the number of boundaries <= osize, so a lookup is a fixed 
+ * run of compares and adds with no data-dependent branches. More than
+ * MAX_BOUNDARIES - 1 boundaries, or boundaries out of order, throw
+ * std::invalid_argument. 
+ */
+class SizeClassMap {
+public:
+	static const size_t MAX_BOUNDARIES = 16;
+
+	osize_t bounds[MAX_BOUNDARIES];
+	size_t num_classes = 1;
+
+	SizeClassMap() {
+		std::fill(bounds, bounds + MAX_BOUNDARIES, 
+				std::numeric_limits<osize_t>::max());
+	}
+
+	SizeClassMap(std::vector<osize_t> boundaries) 
+		: SizeClassMap() {
+		if (boundaries.size() >= MAX_BOUNDARIES) {
+			throw std::invalid_argument("at most " + 
+					std::to_string(MAX_BOUNDARIES - 1) + 
+					" size class boundaries");
+		}
+		if (std::adjacent_find(boundaries.begin(), boundaries.end(), 
+					std::greater_equal<osize_t>()) != boundaries.end()) {
+			throw std::invalid_argument("size class boundaries must be "
+					"strictly ascending");
+		}
+		std::copy(boundaries.begin(), boundaries.end(), bounds);
+		num_classes = boundaries.size() + 1;
+	}
+
+	size_t lookup(osize_t osize) const {
+		size_t cls = 0;
+		for (size_t i = 0; i < MAX_BOUNDARIES; ++i) {
+			cls += (osize >= bounds[i]);
+		}
+		// Only a size equal to the padding value can overshoot
+		return std::min(cls, num_classes - 1);
+	}
+
+	std::string to_json(std::string name) {
+		std::vector<size_t> b(bounds, bounds + num_classes - 1);
+		return print_segment_data(b, name);
+	}
+};
+
+#endif  // PARTITION_STATS_H
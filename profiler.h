@@ -0,0 +1,97 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "common.h"
+
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Time stamp counter where available, steady_clock nanoseconds elsewhere
+inline uint64_t profile_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline const char *profile_clock_unit() {
+#if defined(__x86_64__) || defined(__i386__)
+	return "tsc_cycles";
+#else
+	return "ns";
+#endif
+}
+
+enum ProfiledCallback {
+	PROF_ON_ACCESS,
+	PROF_ON_HIT,
+	PROF_ON_MISS,
+	PROF_ON_INSERT_ATTEMPT,
+	PROF_ON_COPYFWD_ATTEMPT,
+	PROF_ON_ERASE,
+	PROF_COLLECT_PERIODIC_STATS,
+	NUM_PROFILED_CALLBACKS,
+};
+
+// Accumulated clock ticks and call counts per stats callback
+class CallbackProfile {
+public:
+	uint64_t ticks[NUM_PROFILED_CALLBACKS] = {};
+	uint64_t calls[NUM_PROFILED_CALLBACKS] = {};
+
+	std::string to_json(std::string name) {
+		static const char *names[NUM_PROFILED_CALLBACKS] = {
+			"on_access", "on_hit", "on_miss", "on_insert_attempt",
+			"on_copyfwd_attempt", "on_erase", "collect_periodic_stats",
+		};
+
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"unit\": \"" + std::string(profile_clock_unit()) + "\"";
+		for (size_t i = 0; i < NUM_PROFILED_CALLBACKS; ++i) {
+			if (!calls[i]) {
+				continue;
+			}
+			str += ",\n\"" + std::string(names[i]) + "\": {";
+			str += "\"calls\": " + std::to_string(calls[i]) + ", ";
+			str += "\"ticks\": " + std::to_string(ticks[i]) + ", ";
+			str += "\"ticks_per_call\": " +
+				std::to_string((double)ticks[i]/calls[i]) + "}";
+		}
+		str += "\n}";
+		return str;
+	}
+};
+
+/*
+ * Charges the time from construction to destruction to one callback. The
+ * disabled specialization is empty, so instrumented callbacks compile to the
+ * same code as uninstrumented ones when the policy turns profiling off.
+ */
+template <bool Enabled>
+class ProfileScope {
+public:
+	CallbackProfile &profile;
+	ProfiledCallback callback;
+	uint64_t start;
+
+	ProfileScope(CallbackProfile &p, ProfiledCallback cb)
+		: profile(p), callback(cb), start(profile_clock()) {
+	}
+
+	~ProfileScope() {
+		profile.ticks[callback] += profile_clock() - start;
+		profile.calls[callback]++;
+	}
+};
+
+template <>
+class ProfileScope<false> {
+public:
+	ProfileScope(CallbackProfile &, ProfiledCallback) {}
+};
+
+#endif  // PROFILER_H
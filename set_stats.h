@@ -0,0 +1,160 @@
+#ifndef SET_STATS_H
+#define SET_STATS_H
+
+#include "common.h"
+
+#include <algorithm>
+#include <numeric>
+
+typedef uint32_t set_t;
+
+/*
+ * Per-set counters for set-associative flash layers, where every insert
+ * rewrites a whole set and a few hot sets can dominate write amplification.
+ * Counters are dense arrays indexed by set ID; summaries are computed only
+ * at collect_periodic_stats() and dump time.
+ *
+ * "writes"/"write_bytes": set rewrites and the object bytes that caused them
+ * "hits": hits served from the set
+ * "fill": the set's occupied bytes, as last reported by on_fill()
+ *
+ * Write skew per segment is the Gini coefficient (0 even, near 1 all in
+ * one set) and max/mean of that segment's per-set write counts.
+ *
+ * Events for a set ID outside [0, num_sets) are dropped and counted in
+ * "out_of_range".
+ */
+class SetStats {
+public:
+	size_t num_sets = 0;
+	size_t set_bytes = 0;
+	size_t top_k = 0;
+	uint64_t out_of_range = 0;
+
+	std::vector<uint32_t> writes;
+	std::vector<uint64_t> write_bytes;
+	std::vector<uint32_t> hits;
+	std::vector<uint32_t> fill;
+
+	std::vector<uint32_t> last_writes;
+	std::vector<double> segment_write_gini;
+	std::vector<double> segment_write_max_mean;
+	std::vector<double> segment_fill;
+
+	SetStats() {}
+
+	SetStats(size_t sets, size_t bytes_per_set, size_t k)
+		: num_sets(sets), set_bytes(bytes_per_set), top_k(k),
+		writes(sets, 0), write_bytes(sets, 0), hits(sets, 0), fill(sets, 0),
+		last_writes(sets, 0) {
+	}
+
+	bool enabled() const {
+		return num_sets != 0;
+	}
+
+	bool check_set(set_t set) {
+		if (set >= num_sets) {
+			out_of_range++;
+			return false;
+		}
+		return true;
+	}
+
+	void on_write(set_t set, osize_t osize) {
+		if (!check_set(set)) {
+			return;
+		}
+		writes[set]++;
+		write_bytes[set] += osize;
+	}
+
+	void on_hit(set_t set) {
+		if (!check_set(set)) {
+			return;
+		}
+		hits[set]++;
+	}
+
+	void on_fill(set_t set, size_t bytes) {
+		if (!check_set(set)) {
+			return;
+		}
+		fill[set] = bytes;
+	}
+
+	template <typename T>
+	static double gini(std::vector<T> values) {
+		std::sort(values.begin(), values.end());
+		double total = 0, weighted = 0;
+		for (size_t i = 0; i < values.size(); ++i) {
+			total += values[i];
+			weighted += (double)(i + 1) * values[i];
+		}
+		if (total == 0) {
+			return 0;
+		}
+		double n = values.size();
+		return 2 * weighted/(n * total) - (n + 1)/n;
+	}
+
+	template <typename T>
+	static double max_over_mean(std::vector<T> const &values) {
+		double total = std::accumulate(values.begin(), values.end(), 0.0);
+		if (total == 0) {
+			return 0;
+		}
+		return *std::max_element(values.begin(), values.end()) * 
+			values.size()/total;
+	}
+
+	void collect_periodic_stats() {
+		std::vector<uint32_t> delta(num_sets);
+		for (size_t s = 0; s < num_sets; ++s) {
+			delta[s] = writes[s] - last_writes[s];
+		}
+		last_writes = writes;
+		segment_write_gini.push_back(gini(delta));
+		segment_write_max_mean.push_back(max_over_mean(delta));
+
+		double total_fill = std::accumulate(fill.begin(), fill.end(), 0.0);
+		segment_fill.push_back(set_bytes ? total_fill/(num_sets * set_bytes) : 0);
+	}
+
+	std::string to_json(std::string name) {
+		std::vector<set_t> hot(num_sets);
+		std::iota(hot.begin(), hot.end(), 0);
+		size_t k = std::min(top_k, num_sets);
+		std::partial_sort(hot.begin(), hot.begin() + k, hot.end(), 
+				[this](set_t a, set_t b) { return writes[a] > writes[b]; });
+
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"num_sets\": " + std::to_string(num_sets) + ",\n";
+		str += "\"out_of_range\": " + std::to_string(out_of_range) + ",\n";
+		str += "\"write_gini\": " + std::to_string(gini(writes)) + ",\n";
+		str += "\"write_max_mean\": " + std::to_string(max_over_mean(writes)) + ",\n";
+		str += "\"hit_gini\": " + std::to_string(gini(hits)) + ",\n";
+		str += "\"hit_max_mean\": " + std::to_string(max_over_mean(hits)) + ",\n";
+
+		str += "\"hot_sets\": [";
+		for (size_t i = 0; i < k; ++i) {
+			set_t s = hot[i];
+			str += "{\"set\": " + std::to_string(s) + 
+				", \"writes\": " + std::to_string(writes[s]) + 
+				", \"write_bytes\": " + std::to_string(write_bytes[s]) + 
+				", \"hits\": " + std::to_string(hits[s]) + 
+				", \"fill\": " + std::to_string(fill[s]) + "}";
+			str += (i + 1 < k) ? ", " : "";
+		}
+		str += "],\n";
+
+		str += print_segment_data(segment_write_gini, "segment_write_gini") + ",\n";
+		str += print_segment_data(segment_write_max_mean, 
+				"segment_write_max_mean") + ",\n";
+		str += print_segment_data(segment_fill, "segment_fill") + "\n";
+		str += "}";
+		return str;
+	}
+};
+
+#endif  // SET_STATS_H
@@ -0,0 +1,110 @@
+#ifndef SHADOW_LRU_H
+#define SHADOW_LRU_H
+
+#include "common.h"
+#include "flat_map.h"
+
+/*
+ * Fully associative LRU cache of a given byte capacity that only tracks
+ * keys, run beside a real cache to tell what full associativity would have
+ * hit. The recency list is intrusive: nodes sit in one flat array linked by
+ * 32-bit indices, with freed nodes reused, and a FlatMap maps keys to nodes,
+ * so an access costs one hash lookup and a few index updates.
+ */
+template <typename K>
+class ShadowLru {
+public:
+	static constexpr uint32_t NIL = UINT32_MAX;
+
+	struct Node {
+		K key;
+		osize_t size;
+		uint32_t prev;
+		uint32_t next;
+	};
+
+	size_t capacity = 0;
+	size_t used = 0;
+	std::vector<Node> nodes;
+	std::vector<uint32_t> free_nodes;
+	FlatMap<K, uint32_t> index;
+	uint32_t head = NIL;  // most recently used
+	uint32_t tail = NIL;
+
+	ShadowLru() {}
+
+	ShadowLru(size_t bytes)
+		: capacity(bytes) {
+	}
+
+	bool enabled() const {
+		return capacity != 0;
+	}
+
+	void unlink(uint32_t n) {
+		Node &node = nodes[n];
+		(node.prev == NIL ? head : nodes[node.prev].next) = node.next;
+		(node.next == NIL ? tail : nodes[node.next].prev) = node.prev;
+	}
+
+	void push_front(uint32_t n) {
+		nodes[n].prev = NIL;
+		nodes[n].next = head;
+		(head == NIL ? tail : nodes[head].prev) = n;
+		head = n;
+	}
+
+	void evict_lru() {
+		uint32_t n = tail;
+		unlink(n);
+		used -= nodes[n].size;
+		index.erase(nodes[n].key);
+		free_nodes.push_back(n);
+	}
+
+	// Drop key, if cached, as when the real cache deletes it
+	void erase(K key) {
+		uint32_t *found = index.find(key);
+		if (!found) {
+			return;
+		}
+		uint32_t n = *found;
+		unlink(n);
+		used -= nodes[n].size;
+		index.erase(key);
+		free_nodes.push_back(n);
+	}
+
+	// Look up key and make it most recent, inserting it on a miss. Returns
+	// whether it was cached. 
+	bool access(K key, osize_t size) {
+		uint32_t *found = index.find(key);
+		if (found) {
+			uint32_t n = *found;
+			unlink(n);
+			push_front(n);
+			used = used - nodes[n].size + size;
+			nodes[n].size = size;
+		} else if (size <= capacity) {
+			uint32_t n;
+			if (free_nodes.empty()) {
+				n = nodes.size();
+				nodes.push_back({});
+			} else {
+				n = free_nodes.back();
+				free_nodes.pop_back();
+			}
+			nodes[n].key = key;
+			nodes[n].size = size;
+			push_front(n);
+			index[key] = n;
+			used += size;
+		}
+		while (used > capacity) {
+			evict_lru();
+		}
+		return found != nullptr;
+	}
+};
+
+#endif  // SHADOW_LRU_H
@@ -0,0 +1,87 @@
+#ifndef SPACE_STATS_H
+#define SPACE_STATS_H
+
+#include "common.h"
+#include "gc_stats.h"
+
+/*
+ * Breakdown of the flash space the cache has written and not yet erased.
+ *
+ * "valid": object bytes the cache still serves
+ * "invalid": object bytes overwritten or evicted, still in their container
+ * "padding": unused capacity at the end of flushed containers
+ *
+ * Writes add to valid; an eviction moves the object to invalid; an object
+ * leaving its container at erase time (copied forward, or dropped) leaves
+ * valid. Erasing a container then frees its invalid bytes and padding, which
+ * takes the container's ID and size, and padding recorded per container ID
+ * at flush. Without container IDs nothing is ever freed from invalid or
+ * padding.
+ */
+class SpaceStats {
+public:
+	int64_t valid = 0;
+	int64_t invalid = 0;
+	int64_t padding = 0;
+	std::vector<uint32_t> container_padding;
+
+	std::vector<size_t> segment_valid;
+	std::vector<size_t> segment_invalid;
+	std::vector<size_t> segment_padding;
+
+	void on_write(osize_t osize) {
+		valid += osize;
+	}
+
+	void on_invalidate(osize_t osize) {
+		valid -= osize;
+		invalid += osize;
+	}
+
+	void on_remove(osize_t osize) {
+		valid -= osize;
+	}
+
+	void on_container_flush(size_t unused_capacity) {
+		padding += unused_capacity;
+	}
+
+	void set_container_padding(container_t id, size_t unused_capacity) {
+		if (id >= container_padding.size()) {
+			container_padding.resize((size_t)id + 1, 0);
+		}
+		container_padding[id] = unused_capacity;
+	}
+
+	void on_container_erase(container_t id, size_t live, size_t capacity) {
+		size_t pad = id < container_padding.size() ? container_padding[id] : 0;
+		if (id < container_padding.size()) {
+			container_padding[id] = 0;
+		}
+		padding -= pad;
+		invalid -= capacity - std::min(capacity, live + pad);
+	}
+
+	void collect_periodic_stats() {
+		segment_valid.push_back(std::max<int64_t>(valid, 0));
+		segment_invalid.push_back(std::max<int64_t>(invalid, 0));
+		segment_padding.push_back(std::max<int64_t>(padding, 0));
+	}
+
+	std::string to_json(std::string name) {
+		int64_t used = valid + invalid + padding;
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"valid_bytes\": " + std::to_string(valid) + ",\n";
+		str += "\"invalid_bytes\": " + std::to_string(invalid) + ",\n";
+		str += "\"padding_bytes\": " + std::to_string(padding) + ",\n";
+		str += "\"valid_fraction\": " + 
+			std::to_string(used > 0 ? (double)valid/used : 0) + ",\n";
+		str += print_segment_data(segment_valid, "segment_valid_bytes") + ",\n";
+		str += print_segment_data(segment_invalid, "segment_invalid_bytes") + ",\n";
+		str += print_segment_data(segment_padding, "segment_padding_bytes") + "\n";
+		str += "}";
+		return str;
+	}
+};
+
+#endif  // SPACE_STATS_H
@@ -0,0 +1,69 @@
+#ifndef STATS_FEATURES_H
+#define STATS_FEATURES_H
+
+#include "common.h"
+
+/*
+ * Feature policies for CacheStatsT and FlashStatsT. Each flag gates one group
+ * of optional statistics at compile time: code for a disabled feature sits
+ * behind `if constexpr` and is discarded, so its state is never touched on the
+ * hot path. The global counters and segment series are always kept; for no
+ * stats at all, use NullCacheStats/NullFlashStats from null_stats.h.
+ *
+ * Policies also pick the key type used by per-key structures and the counter
+ * type (object count width) of the named counters.
+ */
+struct DefaultStatsFeatures {
+	typedef okey_t key_type;
+	typedef Counter counter_type;
+
+	// Segment series for copy-forwards, objects written and reinserts. Still
+	// subject to FlashStats' runtime record_segment_byte_breakdown flag.
+	static constexpr bool segment_breakdown = true;
+	// Per-key state: the reinsert set and per-key copy-forward counts
+	static constexpr bool per_key_tracking = true;
+	// copyfwd_hist (needs per_key_tracking)
+	static constexpr bool histograms = true;
+	// Tenant and size-class partitions
+	static constexpr bool partitions = true;
+	// Per-tier hit/miss accounting
+	static constexpr bool tiers = true;
+	// Per-container state: GC efficiency on erase (gc_stats.h)
+	static constexpr bool container_stats = true;
+	// Per-callback clock ticks and call counts (profiler.h)
+	static constexpr bool profiling = false;
+	// Raw event records to an attached EventLog (event_log.h)
+	static constexpr bool event_log = true;
+};
+
+// Only the global counters and segment series; for fast parameter sweeps
+struct SweepStatsFeatures {
+	typedef okey_t key_type;
+	typedef Counter counter_type;
+
+	static constexpr bool segment_breakdown = false;
+	static constexpr bool per_key_tracking = false;
+	static constexpr bool histograms = false;
+	static constexpr bool partitions = false;
+	static constexpr bool tiers = false;
+	static constexpr bool container_stats = false;
+	static constexpr bool profiling = false;
+	static constexpr bool event_log = false;
+};
+
+// Full 64-bit keys, for traces whose keys do not fit okey_t
+struct WideKeyStatsFeatures : DefaultStatsFeatures {
+	typedef uint64_t key_type;
+};
+
+// 32-bit keys and object counts, for traces under 2^32 requests
+struct CompactStatsFeatures : DefaultStatsFeatures {
+	typedef CompactCounter counter_type;
+};
+
+// Default features, plus timing of the stats callbacks themselves
+struct ProfiledStatsFeatures : DefaultStatsFeatures {
+	static constexpr bool profiling = true;
+};
+
+#endif  // STATS_FEATURES_H
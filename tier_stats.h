@@ -0,0 +1,144 @@
+#ifndef TIER_STATS_H
+#define TIER_STATS_H
+
+#include "common.h"
+#include "partition_stats.h"
+
+#include <stdexcept>
+
+typedef uint8_t tier_t;
+
+// Default tier IDs, ordered from the top of the hierarchy down
+enum StandardTier : tier_t {
+	TIER_DRAM,
+	TIER_FLASH_LOG,
+	TIER_FLASH_SETS,
+	TIER_BACKEND,
+};
+
+/*
+ * Hit/miss accounting for an N-level cache hierarchy. A request looks up tier
+ * 0 first and walks down until some tier hits; tiers are identified by small
+ * integer IDs in lookup order.
+ *
+ * "lookups": requests that reached the tier
+ * "hits": ...and were served by it; bytes here are the bytes served
+ * "misses": ...and went on to the next tier
+ *
+ * Exclusive hit ratio of a tier is hits/lookups at that tier; inclusive hit
+ * ratio is the fraction of all requests served by that tier or one above it.
+ * Requests are the lookups at tier 0. A tier ID outside the configured tiers
+ * throws std::out_of_range.
+ */
+class TierStats {
+public:
+	enum TierCounter {
+		T_LOOKUPS,
+		T_HITS,
+		T_MISSES,
+	};
+
+	std::vector<std::string> tier_names;
+	PartitionedCounters tiers;
+
+	TierStats() {}
+
+	TierStats(std::vector<std::string> names)
+		: tier_names(names),
+		tiers({"lookups", "hits", "misses"}, names.size()) {
+	}
+
+	bool enabled() const {
+		return tiers.enabled();
+	}
+
+	void check_tier(tier_t tier) const {
+		if (tier >= tier_names.size()) {
+			throw std::out_of_range("unknown tier " + std::to_string(tier));
+		}
+	}
+
+	void on_hit(tier_t tier, osize_t osize) {
+		check_tier(tier);
+		tiers.increment(T_LOOKUPS, tier, osize);
+		tiers.increment(T_HITS, tier, osize);
+	}
+
+	void on_miss(tier_t tier, osize_t osize) {
+		check_tier(tier);
+		tiers.increment(T_LOOKUPS, tier, osize);
+		tiers.increment(T_MISSES, tier, osize);
+	}
+
+	// A request that missed every tier above `tier` and was served by it
+	void on_served_from(tier_t tier, osize_t osize) {
+		check_tier(tier);
+		for (tier_t t = 0; t < tier; ++t) {
+			on_miss(t, osize);
+		}
+		on_hit(tier, osize);
+	}
+
+	counter_t get(TierCounter counter, tier_t tier, bool bytes) const {
+		check_tier(tier);
+		size_t idx = counter * tiers.num_partitions + tier;
+		return bytes ? tiers.bytes[idx] : tiers.objects[idx];
+	}
+
+	double exclusive_hit_ratio(tier_t tier, bool bytes) const {
+		counter_t lookups = get(T_LOOKUPS, tier, bytes);
+		return lookups ? (double)get(T_HITS, tier, bytes)/lookups : 0;
+	}
+
+	double inclusive_hit_ratio(tier_t tier, bool bytes) const {
+		counter_t hits = 0;
+		for (tier_t t = 0; t <= tier; ++t) {
+			hits += get(T_HITS, t, bytes);
+		}
+		counter_t requests = get(T_LOOKUPS, 0, bytes);
+		return requests ? (double)hits/requests : 0;
+	}
+
+	void collect_periodic_stats() {
+		tiers.collect_periodic_stats();
+	}
+
+	void print_periodic_stats() {
+		for (size_t t = 0; t < tier_names.size(); ++t) {
+			std::cout << "\tTier " << tier_names[t]
+				<< " OHR: " << exclusive_hit_ratio(t, false)
+				<< ", inclusive " << inclusive_hit_ratio(t, false) << "\n";
+		}
+	}
+
+	std::string to_json(std::string name) {
+		std::string str = "\"" + name + "\": {\n";
+
+		str += "\"tier_names\": [";
+		for (size_t t = 0; t < tier_names.size(); ++t) {
+			str += "\"" + tier_names[t] + "\"";
+			str += (t + 1 < tier_names.size()) ? ", " : "],\n";
+		}
+
+		std::string ratios[4] = {
+			"\"exclusive_bhr\": [", "\"exclusive_ohr\": [",
+			"\"inclusive_bhr\": [", "\"inclusive_ohr\": [",
+		};
+		for (size_t t = 0; t < tier_names.size(); ++t) {
+			std::string sep = (t + 1 < tier_names.size()) ? ", " : "],\n";
+			ratios[0] += std::to_string(exclusive_hit_ratio(t, true)) + sep;
+			ratios[1] += std::to_string(exclusive_hit_ratio(t, false)) + sep;
+			ratios[2] += std::to_string(inclusive_hit_ratio(t, true)) + sep;
+			ratios[3] += std::to_string(inclusive_hit_ratio(t, false)) + sep;
+		}
+		for (auto &r : ratios) {
+			str += r;
+		}
+
+		str += tiers.to_json("counters") + "\n";
+		str += "}";
+		return str;
+	}
+};
+
+#endif  // TIER_STATS_H
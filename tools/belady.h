@@ -0,0 +1,125 @@
+#ifndef TOOLS_BELADY_H
+#define TOOLS_BELADY_H
+
+#include "../flat_map.h"
+
+#include <algorithm>
+#include <queue>
+#include <thread>
+
+struct OptResult {
+	size_t cache_bytes = 0;
+	uint64_t hits = 0;
+	uint64_t hit_bytes = 0;
+	uint64_t requests = 0;
+	uint64_t request_bytes = 0;
+
+	double ohr() const {
+		return requests ? (double)hits/requests : 0;
+	}
+
+	double bhr() const {
+		return request_bytes ? (double)hit_bytes/request_bytes : 0;
+	}
+};
+
+/*
+ * Offline Belady (OPT) over a recorded access stream. add() appends
+ * accesses; build() links each access to the next access of the same key in
+ * one backward pass, into a flat array of 32-bit indices. simulate() then
+ * replays the stream with full knowledge of the future: on a miss the
+ * object is admitted, and while the cache is over capacity the object whose
+ * next access is furthest away is evicted (possibly the new one, i.e. it is
+ * bypassed); objects never accessed again are not kept at all.
+ *
+ * With equal sizes this is exactly OPT. With variable sizes, exact OPT is
+ * NP-hard and furthest-next-access is the usual baseline; treat the byte hit
+ * ratio in particular as a near-optimal reference rather than a bound.
+ */
+class BeladyOpt {
+public:
+	static constexpr uint32_t NO_NEXT = UINT32_MAX;
+
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> sizes;
+	std::vector<uint32_t> next;
+
+	void add(uint64_t key, uint32_t size) {
+		keys.push_back(key);
+		sizes.push_back(size);
+	}
+
+	void build() {
+		if (keys.size() >= NO_NEXT) {
+			throw std::length_error("Belady needs fewer than 2^32 accesses");
+		}
+		next.assign(keys.size(), NO_NEXT);
+		FlatMap<uint64_t, uint32_t> last_seen;
+		for (size_t i = keys.size(); i-- > 0;) {
+			uint32_t &seen = last_seen[keys[i]];
+			// Values start at 0, so stored indices are off by one
+			next[i] = seen ? seen - 1 : NO_NEXT;
+			seen = i + 1;
+		}
+		// Keys are only needed to build the index
+		std::vector<uint64_t>().swap(keys);
+	}
+
+	OptResult simulate(size_t cache_bytes) const {
+		OptResult r;
+		r.cache_bytes = cache_bytes;
+
+		// cached[j]: size of the object whose next access is j, 0 if none
+		std::vector<uint32_t> cached(next.size(), 0);
+		std::priority_queue<uint32_t> by_next;
+		size_t used = 0;
+
+		for (size_t i = 0; i < next.size(); ++i) {
+			r.requests++;
+			r.request_bytes += sizes[i];
+			if (cached[i]) {
+				r.hits++;
+				r.hit_bytes += sizes[i];
+				used -= cached[i];
+				cached[i] = 0;  // its heap entry is now stale
+			}
+
+			uint32_t n = next[i];
+			if (n == NO_NEXT || sizes[i] == 0 || sizes[i] > cache_bytes) {
+				continue;
+			}
+			cached[n] = sizes[i];
+			used += sizes[i];
+			by_next.push(n);
+
+			while (used > cache_bytes) {
+				uint32_t victim = by_next.top();
+				by_next.pop();
+				used -= cached[victim];
+				cached[victim] = 0;
+			}
+		}
+		return r;
+	}
+
+	// One simulation per size, on up to num_threads threads
+	std::vector<OptResult> simulate(std::vector<size_t> const &cache_sizes, 
+			size_t num_threads) const {
+		std::vector<OptResult> results(cache_sizes.size());
+		num_threads = std::max((size_t)1, std::min(num_threads, cache_sizes.size()));
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < num_threads; ++t) {
+			workers.emplace_back([&, t] {
+				for (size_t s = t; s < cache_sizes.size(); s += num_threads) {
+					results[s] = simulate(cache_sizes[s]);
+				}
+			});
+		}
+		for (auto &w : workers) {
+			w.join();
+		}
+		return results;
+	}
+};
+
+#endif  // TOOLS_BELADY_H
@@ -0,0 +1,238 @@
+#ifndef TOOLS_FLASH_CACHE_MODEL_H
+#define TOOLS_FLASH_CACHE_MODEL_H
+
+#include "../common.h"
+#include "trace.h"
+
+#include <deque>
+#include <list>
+
+struct FlashCacheConfig {
+	size_t dram_bytes = 0;
+	size_t flash_bytes = (size_t)1 << 30;
+	size_t container_bytes = (size_t)1 << 20;
+	// FIFO drops every object in the victim container; LRU copies forward
+	// the ones read since they were last written
+	bool lru = false;
+	// Number of misses on a key before it is admitted to flash
+	uint32_t admit_after = 1;
+	int period = 100000;
+};
+
+/*
+ * Reference cache used by the replay tools: an optional DRAM LRU in front of
+ * a log-structured flash cache made of fixed-size containers, evicted oldest
+ * container first. It drives the same callbacks a simulator would, so the
+ * stats types are template parameters (NullCacheStats/NullFlashStats measure
+ * the model alone).
+ */
+template <typename CStats, typename FStats>
+class FlashCacheModel {
+public:
+	// Keys narrower than the trace's are truncated
+	typedef typename FStats::key_type key_type;
+
+	struct Entry {
+		uint32_t container;
+		osize_t size;
+		bool read;
+	};
+
+	FlashCacheConfig config;
+	CStats cache_stats;
+	FStats flash_stats;
+
+	// DRAM
+	std::list<key_type> dram_lru;
+	std::unordered_map<key_type, std::pair<typename std::list<key_type>::iterator, osize_t>> dram_index;
+	size_t dram_used = 0;
+
+	// Flash. Container key lists may hold stale keys that have since been
+	// rewritten elsewhere; index is the source of truth.
+	std::unordered_map<key_type, Entry> index;
+	std::vector<std::vector<key_type>> containers;
+	std::vector<size_t> container_fill;
+	std::deque<uint32_t> sealed;
+	std::vector<uint32_t> free_containers;
+	uint32_t open_container = 0;
+	std::unordered_map<key_type, uint32_t> miss_counts;
+
+	size_t live_bytes = 0;
+	uint64_t requests = 0;
+
+	FlashCacheModel(FlashCacheConfig c)
+		: config(c), cache_stats(c.period), flash_stats(c.period, false) {
+		size_t n = std::max((size_t)2, config.flash_bytes / config.container_bytes);
+		containers.resize(n);
+		container_fill.resize(n, 0);
+		for (uint32_t i = n - 1; i > 0; --i) {
+			free_containers.push_back(i);
+		}
+		open_container = 0;
+	}
+
+	void process(const Request &r) {
+		key_type key = (key_type)r.key;
+		osize_t size = r.size;
+		flash_stats.set_trace_time(r.timestamp);
+
+		switch (r.op) {
+		case OP_GET:
+			get(key, size);
+			break;
+		case OP_SET:
+			invalidate(key);
+			insert(key, size, true);
+			break;
+		case OP_DELETE:
+			invalidate(key);
+			break;
+		}
+
+		if (++requests % config.period == 0) {
+			cache_stats.collect_periodic_stats();
+			flash_stats.collect_periodic_stats(live_bytes);
+		}
+	}
+
+	void get(key_type key, osize_t size) {
+		cache_stats.on_keyed_access(key, size);
+
+		if (config.dram_bytes) {
+			auto it = dram_index.find(key);
+			if (it != dram_index.end()) {
+				dram_lru.splice(dram_lru.begin(), dram_lru, it->second.first);
+				cache_stats.on_dram_hit(size);
+				cache_stats.on_hit(size);
+				return;
+			}
+			cache_stats.on_dram_miss(size);
+		}
+
+		flash_stats.on_access(size);
+		auto it = index.find(key);
+		if (it != index.end()) {
+			it->second.read = true;
+			flash_stats.on_hit(key, it->second.size);
+			cache_stats.on_hit(size);
+		} else {
+			flash_stats.on_miss(key, size);
+			cache_stats.on_miss(size);
+			bool admit = ++miss_counts[key] >= config.admit_after;
+			bool in_dram = config.dram_bytes && size <= config.dram_bytes;
+			if (!insert(key, size, admit) && !in_dram) {
+				cache_stats.on_admission_reject(key);
+			}
+		}
+		dram_insert(key, size);
+	}
+
+	// Returns whether the object was written to flash
+	bool insert(key_type key, osize_t size, bool admit) {
+		admit = admit && size <= config.container_bytes;
+		flash_stats.on_insert_attempt(key, size, admit);
+		cache_stats.on_insert_attempt(size, admit);
+		if (admit) {
+			miss_counts.erase(key);
+			write(key, size);
+		}
+		return admit;
+	}
+
+	void invalidate(key_type key) {
+		cache_stats.on_invalidate(key);
+		auto d = dram_index.find(key);
+		if (d != dram_index.end()) {
+			dram_used -= d->second.second;
+			dram_lru.erase(d->second.first);
+			dram_index.erase(d);
+		}
+
+		auto it = index.find(key);
+		if (it != index.end()) {
+			flash_stats.on_invalidate(key, it->second.size);
+			live_bytes -= it->second.size;
+			index.erase(it);
+		}
+	}
+
+	void dram_insert(key_type key, osize_t size) {
+		if (!config.dram_bytes || size > config.dram_bytes) {
+			return;
+		}
+		while (dram_used + size > config.dram_bytes) {
+			key_type victim = dram_lru.back();
+			// Its only copy, if flash has not admitted it yet
+			if (!index.count(victim) && miss_counts.count(victim)) {
+				cache_stats.on_admission_reject(victim);
+			}
+			dram_used -= dram_index[victim].second;
+			dram_index.erase(victim);
+			dram_lru.pop_back();
+		}
+		dram_lru.push_front(key);
+		dram_index[key] = {dram_lru.begin(), size};
+		dram_used += size;
+	}
+
+	void write(key_type key, osize_t size) {
+		// Copy-forwards into the new container may leave too little room
+		while (container_fill[open_container] + size > config.container_bytes) {
+			seal_and_open();
+		}
+		containers[open_container].push_back(key);
+		container_fill[open_container] += size;
+		index[key] = {open_container, size, false};
+		live_bytes += size;
+		flash_stats.on_write(size);
+	}
+
+	void seal_and_open() {
+		flash_stats.on_container_flush(open_container,
+				config.container_bytes - container_fill[open_container]);
+		sealed.push_back(open_container);
+
+		if (!free_containers.empty()) {
+			open_container = free_containers.back();
+			free_containers.pop_back();
+			return;
+		}
+
+		// Reclaim the oldest container and reuse it as the open one,
+		// starting with whatever gets copied forward out of it.
+		uint32_t victim = sealed.front();
+		sealed.pop_front();
+
+		std::vector<std::pair<key_type, osize_t>> survivors;
+		size_t victim_live = 0;
+		for (auto key : containers[victim]) {
+			auto it = index.find(key);
+			if (it == index.end() || it->second.container != victim) {
+				continue;
+			}
+			osize_t size = it->second.size;
+			victim_live += size;
+			bool keep = config.lru && it->second.read;
+			if (config.lru) {
+				flash_stats.on_copyfwd_attempt(key, size, keep);
+			}
+			live_bytes -= size;
+			index.erase(it);
+			if (keep) {
+				survivors.push_back({key, size});
+			} else {
+				flash_stats.on_erase(key, size);
+			}
+		}
+		containers[victim].clear();
+		container_fill[victim] = 0;
+		flash_stats.on_container_erase(victim, victim_live, config.container_bytes);
+
+		open_container = victim;
+		for (auto &s : survivors) {
+			write(s.first, s.second);
+		}
+	}
+};
+
+#endif  // TOOLS_FLASH_CACHE_MODEL_H
@@ -0,0 +1,191 @@
+/*
+ * Offline OPT baseline: reads an access stream and prints the Belady hit
+ * ratios (see tools/belady.h) for one or more cache sizes, simulated in
+ * parallel.
+ *
+ * Build from the repository root:
+ *   g++ -O2 -std=c++17 -I. tools/opt.cc common.cc -o opt -pthread
+ *
+ * Usage: opt INPUT --cache-bytes N,N,... [options]
+ *   INPUT is a packed binary trace (tools/trace.h), of which the GETs are
+ *   used, or an event log written by replay --event-log (event_log.h), of
+ *   which the CacheStats keyed accesses are used: the same stream CacheStats
+ *   computes OHR/BHR over. A log without keyed accesses falls back to the
+ *   FlashStats hits and misses, and the output is labelled as a flash-tier
+ *   bound, since DRAM hits never reach flash.
+ *   --threads N           worker threads (default: hardware concurrency)
+ *   --json PATH           also write the results to PATH
+ */
+#include "event_log.h"
+#include "tools/belady.h"
+#include "tools/trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+struct OptOptions {
+	std::string input;
+	std::vector<size_t> cache_bytes;
+	size_t threads = std::thread::hardware_concurrency();
+	std::string json;
+};
+
+void usage(const char *prog) {
+	std::cerr << "Usage: " << prog << " INPUT --cache-bytes N,N,... "
+		<< "[--threads N] [--json PATH]" << std::endl;
+	std::exit(1);
+}
+
+std::vector<size_t> parse_list(std::string s) {
+	std::vector<size_t> values;
+	std::stringstream ss(s);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		values.push_back(std::stoull(item));
+	}
+	return values;
+}
+
+OptOptions parse_args(int argc, char **argv) {
+	OptOptions opts;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) {
+				usage(argv[0]);
+			}
+			return argv[++i];
+		};
+
+		if (arg == "--cache-bytes") {
+			opts.cache_bytes = parse_list(value());
+		} else if (arg == "--threads") {
+			opts.threads = std::stoull(value());
+		} else if (arg == "--json") {
+			opts.json = value();
+		} else if (arg[0] == '-' || !opts.input.empty()) {
+			usage(argv[0]);
+		} else {
+			opts.input = arg;
+		}
+	}
+	if (opts.input.empty() || opts.cache_bytes.empty()) {
+		usage(argv[0]);
+	}
+	return opts;
+}
+
+bool is_event_log(std::string path) {
+	std::ifstream in(path, std::ios::binary);
+	EventLogHeader header;
+	if (!in.read((char *)&header, sizeof(header))) {
+		return false;
+	}
+	return std::memcmp(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic)) == 0;
+}
+
+// Which accesses the OPT run covers
+enum OptStream {
+	STREAM_TRACE,
+	STREAM_CACHE,
+	STREAM_FLASH,
+};
+
+const char *stream_names[] = {"trace_gets", "cache_accesses", 
+	"flash_accesses"};
+
+OptStream load_event_log(std::string path, BeladyOpt &opt) {
+	std::ifstream in(path, std::ios::binary);
+	EventLogHeader header;
+	in.read((char *)&header, sizeof(header));
+	if (header.version != EVENT_LOG_VERSION || 
+			header.record_size != sizeof(EventRecord)) {
+		throw std::runtime_error("Unsupported event log " + path);
+	}
+
+	// Keep the flash accesses aside until it is clear that there are no 
+	// keyed cache accesses to use instead
+	BeladyOpt flash;
+	bool keyed = false;
+	std::vector<EventRecord> batch(1 << 16);
+	while (in) {
+		in.read((char *)batch.data(), batch.size() * sizeof(EventRecord));
+		size_t n = in.gcount() / sizeof(EventRecord);
+		for (size_t i = 0; i < n; ++i) {
+			auto const &e = batch[i];
+			if (e.source == SRC_CACHE && e.type == EV_KEYED_ACCESS) {
+				if (!keyed) {
+					flash = BeladyOpt();
+					keyed = true;
+				}
+				opt.add(e.key, e.size);
+			} else if (!keyed && e.source == SRC_FLASH && 
+					(e.type == EV_HIT || e.type == EV_MISS)) {
+				flash.add(e.key, e.size);
+			}
+		}
+	}
+	if (keyed) {
+		return STREAM_CACHE;
+	}
+	std::swap(opt, flash);
+	return STREAM_FLASH;
+}
+
+void load_trace(std::string path, BeladyOpt &opt) {
+	MappedTrace trace(path);
+	for (auto const &r : trace) {
+		if (r.op == OP_GET) {
+			opt.add(r.key, r.size);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	OptOptions opts = parse_args(argc, argv);
+
+	auto start = std::chrono::steady_clock::now();
+	BeladyOpt opt;
+	OptStream stream = STREAM_TRACE;
+	if (is_event_log(opts.input)) {
+		stream = load_event_log(opts.input, opt);
+	} else {
+		load_trace(opts.input, opt);
+	}
+	size_t accesses = opt.sizes.size();
+	opt.build();
+	auto built = std::chrono::steady_clock::now();
+
+	auto results = opt.simulate(opts.cache_bytes, opts.threads);
+	auto end = std::chrono::steady_clock::now();
+
+	std::cout << "Indexed " << accesses << " accesses in " 
+		<< std::chrono::duration<double>(built - start).count() << " s, "
+		<< "simulated " << results.size() << " sizes in "
+		<< std::chrono::duration<double>(end - built).count() << " s" 
+		<< std::endl;
+	if (stream == STREAM_FLASH) {
+		std::cout << "No keyed cache accesses in the log; this is OPT over "
+			<< "the flash tier's accesses only, not comparable to the "
+			<< "CacheStats OHR/BHR" << std::endl;
+	}
+
+	std::string str = "{\n\"stream\": \"" + 
+		std::string(stream_names[stream]) + "\",\n\"opt\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		auto const &r = results[i];
+		std::cout << "cache_bytes " << r.cache_bytes << "\tOPT OHR " << r.ohr() 
+			<< "\tOPT BHR " << r.bhr() << std::endl;
+		str += "{\"cache_bytes\": " + std::to_string(r.cache_bytes) + 
+			", \"ohr\": " + std::to_string(r.ohr()) + 
+			", \"bhr\": " + std::to_string(r.bhr()) + "}";
+		str += (i + 1 < results.size()) ? ",\n" : "";
+	}
+	str += "]\n}";
+
+	if (!opts.json.empty()) {
+		std::ofstream(opts.json) << str << std::endl;
+	}
+	return 0;
+}
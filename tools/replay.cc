@@ -0,0 +1,404 @@
+/*
+ * End-to-end replay driver: memory-maps a packed binary trace (see
+ * tools/trace.h), runs it through the reference flash cache model and feeds
+ * CacheStats and FlashStats, then reports replay throughput.
+ *
+ * Build from the repository root:
+ *   g++ -O2 -std=c++17 -I. tools/replay.cc common.cc -o replay -pthread
+ *
+ * Usage: replay TRACE [options]
+ *   --flash-bytes N       flash capacity (default 1 GiB)
+ *   --container-bytes N   container size (default 1 MiB)
+ *   --dram-bytes N        DRAM LRU in front of flash (default 0, none)
+ *   --policy fifo|lru     container eviction policy (default fifo)
+ *   --admit-after N       misses before a key is admitted (default 1)
+ *   --period N            requests per stats segment (default 100000)
+ *   --null-stats          use NullCacheStats/NullFlashStats, to measure
+ *                         the model without the stats layer
+ *   --compact             32-bit keys and object counts (CompactStatsFeatures)
+ *                         instead of full 64-bit trace keys
+ *   --profile             time each stats callback (profiler.h); the
+ *                         breakdown goes in the JSON dumps
+ *   --json PREFIX         write PREFIX.cache.json and PREFIX.flash.json
+ *   --event-log PATH      record every stats callback to PATH (event_log.h)
+ *   --shadow-lru          split misses into compulsory, capacity and conflict
+ *                         against a fully associative LRU of the same size
+ *   --heavy-hitters N     top N keys by missed and written bytes (with 16N
+ *                         Space-Saving counters each)
+ *   --ghost-entries N     classify misses on the last N evicted keys as
+ *                         bad-choice misses
+ *   --skip-history N      count later misses on the last N skipped inserts
+ *   --prune-history N     ...and on the last N pruned copy-forwards
+ *   --ewma N              keep decayed OHR/BHR/WA with a half-life of N
+ *                         requests (ewma.h) and report the final values
+ *   --ewma-seconds S      half-life of the decayed write rate, in trace
+ *                         seconds (default 60)
+ *   --rated-pe N          model flash wear for a device of --flash-bytes rated
+ *                         for N P/E cycles (endurance_stats.h)
+ *   --ftl greedy|cost-benefit
+ *                         simulate device GC under the containers (ftl_sim.h)
+ *   --ftl-op F            FTL over-provisioning fraction (default 0.07)
+ *   --zone-bytes N        account containers as appends to zones of N bytes
+ *                         (zns_stats.h)
+ *   --open-zones N        zones written at once, containers striped round
+ *                         robin over them (default 1)
+ *   --max-active-zones N  device active zone limit; zones are finished early
+ *                         to stay under it
+ *
+ * Sweep mode replays the trace once through one model per combination of the
+ * listed values, in parallel (see tools/sweep.h):
+ *   --sweep-flash-bytes N,N,...
+ *   --sweep-admit-after N,N,...
+ *   --threads N           worker threads (default: hardware concurrency)
+ *   --batch N             requests decoded per batch (default 65536)
+ * The stats feature options above apply to every model. --null-stats,
+ * --compact, --profile and --event-log are rejected in sweep mode. With
+ * --json, each configuration i writes PREFIX.i.cache.json and
+ * PREFIX.i.flash.json.
+ */
+#include "cache_stats.h"
+#include "flash_stats.h"
+#include "null_stats.h"
+#include "tools/flash_cache_model.h"
+#include "tools/sweep.h"
+#include "tools/trace.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+struct ReplayOptions {
+	std::string trace;
+	FlashCacheConfig cache;
+	bool null_stats = false;
+	bool compact = false;
+	bool profile = false;
+	std::string json_prefix;
+	std::string event_log;
+	bool shadow_lru = false;
+	size_t heavy_hitters = 0;
+	size_t ghost_entries = 0;
+	size_t skip_history = 0;
+	size_t prune_history = 0;
+	double ewma = 0;
+	double ewma_seconds = 60;
+	uint32_t rated_pe = 0;
+	std::string ftl;
+	double ftl_op = 0.07;
+	size_t zone_bytes = 0;
+	uint32_t open_zones = 1;
+	uint32_t max_active_zones = 0;
+
+	std::vector<size_t> sweep_flash_bytes;
+	std::vector<size_t> sweep_admit_after;
+	size_t threads = std::thread::hardware_concurrency();
+	size_t batch = 65536;
+};
+
+void usage(const char *prog) {
+	std::cerr << "Usage: " << prog << " TRACE [--flash-bytes N] "
+		<< "[--container-bytes N] [--dram-bytes N] [--policy fifo|lru] "
+		<< "[--admit-after N] [--period N] [--null-stats] [--compact] [--profile] "
+		<< "[--json PREFIX] [--event-log PATH] [--shadow-lru] "
+		<< "[--heavy-hitters N] [--ghost-entries N] "
+		<< "[--skip-history N] [--prune-history N] "
+		<< "[--ewma N] [--ewma-seconds S] [--rated-pe N] "
+		<< "[--ftl greedy|cost-benefit] [--ftl-op F] "
+		<< "[--zone-bytes N] [--open-zones N] [--max-active-zones N] "
+		<< "[--sweep-flash-bytes N,...] [--sweep-admit-after N,...] "
+		<< "[--threads N] [--batch N]" << std::endl;
+	std::exit(1);
+}
+
+std::vector<size_t> parse_list(std::string s) {
+	std::vector<size_t> values;
+	std::stringstream ss(s);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		values.push_back(std::stoull(item));
+	}
+	return values;
+}
+
+ReplayOptions parse_args(int argc, char **argv) {
+	ReplayOptions opts;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) {
+				usage(argv[0]);
+			}
+			return argv[++i];
+		};
+
+		if (arg == "--flash-bytes") {
+			opts.cache.flash_bytes = std::stoull(value());
+		} else if (arg == "--container-bytes") {
+			opts.cache.container_bytes = std::stoull(value());
+		} else if (arg == "--dram-bytes") {
+			opts.cache.dram_bytes = std::stoull(value());
+		} else if (arg == "--policy") {
+			std::string p = value();
+			if (p != "fifo" && p != "lru") {
+				usage(argv[0]);
+			}
+			opts.cache.lru = (p == "lru");
+		} else if (arg == "--admit-after") {
+			opts.cache.admit_after = std::stoul(value());
+		} else if (arg == "--period") {
+			opts.cache.period = std::stoi(value());
+		} else if (arg == "--null-stats") {
+			opts.null_stats = true;
+		} else if (arg == "--compact") {
+			opts.compact = true;
+		} else if (arg == "--profile") {
+			opts.profile = true;
+		} else if (arg == "--json") {
+			opts.json_prefix = value();
+		} else if (arg == "--event-log") {
+			opts.event_log = value();
+		} else if (arg == "--shadow-lru") {
+			opts.shadow_lru = true;
+		} else if (arg == "--heavy-hitters") {
+			opts.heavy_hitters = std::stoull(value());
+		} else if (arg == "--ghost-entries") {
+			opts.ghost_entries = std::stoull(value());
+		} else if (arg == "--skip-history") {
+			opts.skip_history = std::stoull(value());
+		} else if (arg == "--prune-history") {
+			opts.prune_history = std::stoull(value());
+		} else if (arg == "--ewma") {
+			opts.ewma = std::stod(value());
+		} else if (arg == "--ewma-seconds") {
+			opts.ewma_seconds = std::stod(value());
+		} else if (arg == "--rated-pe") {
+			opts.rated_pe = std::stoul(value());
+		} else if (arg == "--ftl") {
+			opts.ftl = value();
+			if (opts.ftl != "greedy" && opts.ftl != "cost-benefit") {
+				usage(argv[0]);
+			}
+		} else if (arg == "--ftl-op") {
+			opts.ftl_op = std::stod(value());
+		} else if (arg == "--zone-bytes") {
+			opts.zone_bytes = std::stoull(value());
+		} else if (arg == "--open-zones") {
+			opts.open_zones = std::stoul(value());
+		} else if (arg == "--max-active-zones") {
+			opts.max_active_zones = std::stoul(value());
+		} else if (arg == "--sweep-flash-bytes") {
+			opts.sweep_flash_bytes = parse_list(value());
+		} else if (arg == "--sweep-admit-after") {
+			opts.sweep_admit_after = parse_list(value());
+		} else if (arg == "--threads") {
+			opts.threads = std::stoull(value());
+		} else if (arg == "--batch") {
+			opts.batch = std::max(1ull, std::stoull(value()));
+		} else if (arg[0] == '-' || !opts.trace.empty()) {
+			usage(argv[0]);
+		} else {
+			opts.trace = arg;
+		}
+	}
+	if (opts.trace.empty()) {
+		usage(argv[0]);
+	}
+	// These pick the stats types or share one output among all models
+	bool sweeping = !opts.sweep_flash_bytes.empty() || 
+		!opts.sweep_admit_after.empty();
+	if (sweeping && (opts.null_stats || opts.compact || opts.profile || 
+				!opts.event_log.empty())) {
+		std::cerr << "--null-stats, --compact, --profile and --event-log "
+			<< "cannot be combined with --sweep-*" << std::endl;
+		std::exit(1);
+	}
+	return opts;
+}
+
+struct ProfiledWideKeyFeatures : WideKeyStatsFeatures {
+	static constexpr bool profiling = true;
+};
+
+// Turn on the optional stats features selected on the command line, sized
+// for this model's configuration
+template <typename Model>
+void enable_features(Model &model, ReplayOptions const &opts) {
+	if (opts.shadow_lru) {
+		model.cache_stats.enable_shadow_lru(model.config.dram_bytes + 
+				model.config.flash_bytes);
+	}
+	if (opts.heavy_hitters) {
+		model.flash_stats.enable_heavy_hitters(16 * opts.heavy_hitters, 
+				opts.heavy_hitters);
+	}
+	if (opts.ghost_entries) {
+		model.flash_stats.enable_ghost_cache(opts.ghost_entries);
+	}
+	if (opts.skip_history) {
+		model.flash_stats.enable_admission_analysis(opts.skip_history);
+	}
+	if (opts.prune_history) {
+		model.flash_stats.enable_copyfwd_analysis(opts.prune_history);
+	}
+	if (opts.ewma) {
+		model.cache_stats.enable_ewma(opts.ewma);
+		model.flash_stats.enable_ewma(opts.ewma, opts.ewma_seconds);
+	}
+	if (opts.rated_pe) {
+		model.flash_stats.enable_endurance_model(
+				model.containers.size() * model.config.container_bytes, 
+				model.config.container_bytes, opts.rated_pe);
+	}
+	if (!opts.ftl.empty()) {
+		FtlConfig ftl;
+		ftl.device_bytes = model.containers.size() * model.config.container_bytes;
+		ftl.container_bytes = model.config.container_bytes;
+		ftl.over_provisioning = opts.ftl_op;
+		ftl.gc_policy = opts.ftl == "greedy" ? FTL_GC_GREEDY : FTL_GC_COST_BENEFIT;
+		model.flash_stats.enable_ftl_model(ftl);
+	}
+	if (opts.zone_bytes) {
+		ZnsConfig zns;
+		zns.zone_bytes = opts.zone_bytes;
+		zns.container_bytes = model.config.container_bytes;
+		zns.open_zones = opts.open_zones;
+		zns.max_active_zones = opts.max_active_zones;
+		model.flash_stats.enable_zns_mode(zns);
+	}
+}
+
+void print_ewma(std::ostream &out, double ohr, double bhr, double write_rate, 
+		double wa) {
+	out << "Recent OHR " << ohr << ", BHR " << bhr << ", flash write rate " 
+		<< write_rate << " bytes/s, WA " << wa << std::endl;
+}
+
+template <typename CStats, typename FStats>
+void replay(ReplayOptions const &opts, MappedTrace const &trace) {
+	FlashCacheModel<CStats, FStats> model(opts.cache);
+	enable_features(model, opts);
+	std::unique_ptr<EventLog> log;
+	if (!opts.event_log.empty()) {
+		log.reset(new EventLog(opts.event_log));
+		model.cache_stats.attach_event_log(log.get());
+		model.flash_stats.attach_event_log(log.get());
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (auto &r : trace) {
+		model.process(Request::decode(r));
+	}
+	auto end = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(end - start).count();
+
+	std::cout << "Replayed " << trace.num_records << " requests in "
+		<< secs << " s: " << trace.num_records / secs << " requests/sec"
+		<< std::endl;
+
+	if (opts.ewma) {
+		print_ewma(std::cout, model.cache_stats.current_ohr(), 
+				model.cache_stats.current_bhr(), 
+				model.flash_stats.current_write_rate(), 
+				model.flash_stats.current_wa());
+	}
+
+	if (log) {
+		log->close();
+		std::cout << "Logged " << log->records_written << " events ("
+			<< log->producer_stalls << " producer stalls)" << std::endl;
+	}
+
+	if (!opts.json_prefix.empty()) {
+		std::ofstream(opts.json_prefix + ".cache.json")
+			<< model.cache_stats.dump_counters_as_json() << std::endl;
+		std::ofstream(opts.json_prefix + ".flash.json")
+			<< model.flash_stats.dump_counters_as_json() << std::endl;
+	}
+}
+
+void sweep(ReplayOptions const &opts, MappedTrace const &trace) {
+	typedef FlashCacheModel<CacheStatsT<WideKeyStatsFeatures>, 
+			FlashStatsT<WideKeyStatsFeatures>> Model;
+
+	auto flash_bytes = opts.sweep_flash_bytes;
+	auto admit_after = opts.sweep_admit_after;
+	if (flash_bytes.empty()) {
+		flash_bytes.push_back(opts.cache.flash_bytes);
+	}
+	if (admit_after.empty()) {
+		admit_after.push_back(opts.cache.admit_after);
+	}
+
+	SweepRunner<Model> runner(opts.threads, opts.batch);
+	for (auto fb : flash_bytes) {
+		for (auto aa : admit_after) {
+			FlashCacheConfig config = opts.cache;
+			config.flash_bytes = fb;
+			config.admit_after = aa;
+			runner.models.emplace_back(new Model(config));
+			enable_features(*runner.models.back(), opts);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	runner.run(trace);
+	auto end = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(end - start).count();
+
+	std::cout << "Replayed " << trace.num_records << " requests through "
+		<< runner.models.size() << " configurations on " << runner.num_threads
+		<< " threads in " << secs << " s: " << trace.num_records / secs
+		<< " requests/sec, " 
+		<< trace.num_records * runner.models.size() / secs 
+		<< " model-requests/sec" << std::endl;
+
+	for (size_t i = 0; i < runner.models.size(); ++i) {
+		auto &m = *runner.models[i];
+		auto &reads = m.cache_stats.counters["total_reads"];
+		auto &hits = m.cache_stats.counters["total_hits"];
+		std::cout << i << "\tflash_bytes " << m.config.flash_bytes
+			<< "\tadmit_after " << m.config.admit_after
+			<< "\tOHR " << (double)hits.object_counter/reads.object_counter
+			<< "\tBHR " << (double)hits.byte_counter/reads.byte_counter
+			<< "\tWA " << (double)m.flash_stats.flash_bytes_written/
+				m.flash_stats.counters["flash_inserts"].byte_counter
+			<< std::endl;
+		if (opts.ewma) {
+			std::cout << "\t";
+			print_ewma(std::cout, m.cache_stats.current_ohr(), 
+					m.cache_stats.current_bhr(), 
+					m.flash_stats.current_write_rate(), 
+					m.flash_stats.current_wa());
+		}
+
+		if (!opts.json_prefix.empty()) {
+			std::string prefix = opts.json_prefix + "." + std::to_string(i);
+			std::ofstream(prefix + ".cache.json")
+				<< m.cache_stats.dump_counters_as_json() << std::endl;
+			std::ofstream(prefix + ".flash.json")
+				<< m.flash_stats.dump_counters_as_json() << std::endl;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	ReplayOptions opts = parse_args(argc, argv);
+	MappedTrace trace(opts.trace);
+
+	if (!opts.sweep_flash_bytes.empty() || !opts.sweep_admit_after.empty()) {
+		sweep(opts, trace);
+	} else if (opts.null_stats) {
+		replay<NullCacheStats, NullFlashStats>(opts, trace);
+	} else if (opts.profile) {
+		replay<CacheStatsT<ProfiledWideKeyFeatures>, 
+			FlashStatsT<ProfiledWideKeyFeatures>>(opts, trace);
+	} else if (opts.compact) {
+		replay<CacheStatsT<CompactStatsFeatures>, 
+			FlashStatsT<CompactStatsFeatures>>(opts, trace);
+	} else {
+		replay<CacheStatsT<WideKeyStatsFeatures>, 
+			FlashStatsT<WideKeyStatsFeatures>>(opts, trace);
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+#ifndef TOOLS_SWEEP_H
+#define TOOLS_SWEEP_H
+
+#include "trace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Replays one trace through many cache models in a single pass. The calling
+ * thread decodes the trace in batches into a double buffer; a fixed pool of
+ * workers, each owning a slice of the models, processes batch i while the
+ * next one is decoded. The trace is read and decoded once however many models
+ * there are.
+ */
+template <typename Model>
+class SweepRunner {
+public:
+	std::vector<std::unique_ptr<Model>> models;
+	size_t num_threads;
+	size_t batch_size;
+
+	std::vector<Request> buffers[2];
+	std::mutex mutex;
+	std::condition_variable work_cv;
+	std::condition_variable done_cv;
+	uint64_t generation = 0;  // batches published so far
+	size_t workers_done = 0;
+	bool finished = false;
+
+	SweepRunner(size_t threads, size_t batch)
+		: num_threads(std::max((size_t)1, threads)), batch_size(batch) {
+	}
+
+	void run(MappedTrace const &trace) {
+		num_threads = std::min(num_threads, models.size());
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < num_threads; ++t) {
+			workers.emplace_back([this, t] { worker(t); });
+		}
+
+		const TraceRecord *next = trace.begin();
+		size_t b = 0;
+		decode(next, trace.end(), buffers[b]);
+		while (!buffers[b].empty()) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				generation++;
+				workers_done = 0;
+			}
+			work_cv.notify_all();
+
+			decode(next, trace.end(), buffers[b ^ 1]);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			done_cv.wait(lock, [this] { return workers_done == num_threads; });
+			b ^= 1;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finished = true;
+			generation++;
+		}
+		work_cv.notify_all();
+		for (auto &w : workers) {
+			w.join();
+		}
+	}
+
+	void decode(const TraceRecord *&next, const TraceRecord *end,
+			std::vector<Request> &batch) {
+		batch.clear();
+		for (size_t i = 0; i < batch_size && next != end; ++i, ++next) {
+			batch.push_back(Request::decode(*next));
+		}
+	}
+
+	void worker(size_t t) {
+		uint64_t seen = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				work_cv.wait(lock, [&] { return generation != seen; });
+				seen = generation;
+				if (finished) {
+					return;
+				}
+			}
+
+			// Batch g (1-based) lives in buffers[(g - 1) % 2]
+			auto const &batch = buffers[(seen - 1) % 2];
+			for (size_t m = t; m < models.size(); m += num_threads) {
+				for (auto const &r : batch) {
+					models[m]->process(r);
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (++workers_done == num_threads) {
+				done_cv.notify_one();
+			}
+		}
+	}
+};
+
+#endif  // TOOLS_SWEEP_H
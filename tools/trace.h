@@ -0,0 +1,97 @@
+#ifndef TOOLS_TRACE_H
+#define TOOLS_TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum TraceOp : uint8_t {
+	OP_GET,
+	OP_SET,
+	OP_DELETE,
+};
+
+// On-disk trace record; a trace file is a packed array of these
+struct __attribute__((packed)) TraceRecord {
+	uint64_t key;
+	uint32_t size;
+	uint8_t op;
+	uint32_t timestamp;  // seconds
+};
+
+// A trace record unpacked into naturally aligned fields
+struct Request {
+	uint64_t key;
+	uint32_t size;
+	uint8_t op;
+	uint32_t timestamp;
+
+	static Request decode(const TraceRecord &r) {
+		return {r.key, r.size, r.op, r.timestamp};
+	}
+};
+
+/*
+ * Read-only memory mapping of a trace file. Records are read in place, so
+ * replay does no parsing or copying and the page cache does the I/O.
+ */
+class MappedTrace {
+public:
+	const TraceRecord *records = nullptr;
+	size_t num_records = 0;
+	size_t length = 0;
+
+	MappedTrace(std::string path) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Cannot open trace " + path);
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0) {
+			close(fd);
+			throw std::runtime_error("Cannot stat trace " + path);
+		}
+		length = st.st_size;
+		num_records = length / sizeof(TraceRecord);
+		if (length % sizeof(TraceRecord)) {
+			std::fprintf(stderr, "Trace %s has a partial trailing record\n",
+					path.c_str());
+		}
+
+		if (length) {
+			void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED) {
+				close(fd);
+				throw std::runtime_error("Cannot map trace " + path);
+			}
+			madvise(p, length, MADV_SEQUENTIAL);
+			records = (const TraceRecord *)p;
+		}
+		close(fd);
+	}
+
+	~MappedTrace() {
+		if (records) {
+			munmap((void *)records, length);
+		}
+	}
+
+	MappedTrace(const MappedTrace &) = delete;
+	MappedTrace &operator=(const MappedTrace &) = delete;
+
+	const TraceRecord *begin() const {
+		return records;
+	}
+
+	const TraceRecord *end() const {
+		return records + num_records;
+	}
+};
+
+#endif  // TOOLS_TRACE_H
@@ -0,0 +1,247 @@
+#ifndef ZNS_STATS_H
+#define ZNS_STATS_H
+
+#include "common.h"
+#include "gc_stats.h"
+
+#include <set>
+#include <stdexcept>
+
+struct ZnsConfig {
+	size_t zone_bytes = 0;
+	size_t container_bytes = 0;
+	size_t num_zones = 0;        // 0: grow as containers appear
+	uint32_t open_zones = 1;     // zones appended to at once
+	uint32_t max_active_zones = 0;  // device limit; 0 for none
+};
+
+/*
+ * Zoned-namespace view of the container log. Container flushes are striped
+ * round robin over open_zones write streams, and each stream appends to its
+ * own open zone, at its write pointer, with the container's used bytes
+ * (container_bytes minus the unused capacity). When the next flush no longer
+ * fits, the stream finishes its zone and opens the lowest-numbered empty one.
+ * A zone is reset once every container appended to it since its last reset
+ * has been erased, and "reset_fill_hist" records how much of the zone had
+ * been written by then, in NUM_BUCKETS equal-width buckets.
+ *
+ * Open zones are the active ones; the host never leaves zones closed. When
+ * opening a zone would go over max_active_zones, the fullest other open zone
+ * is finished early ("early_finishes"), and the capacity it leaves unwritten
+ * is counted in "early_finish_bytes"; this is what a max_active_zones below
+ * open_zones costs in zone fill. With num_zones set, "empty_zone_shortfalls"
+ * counts opens that found no empty zone, which would stall a real device;
+ * the zone count grows instead.
+ */
+class ZnsStats {
+public:
+	static const size_t NUM_BUCKETS = 10;
+	static constexpr uint32_t NO_ZONE = UINT32_MAX;
+	enum ZoneState : uint8_t {
+		Z_EMPTY,
+		Z_OPEN,
+		Z_FULL,
+	};
+
+	ZnsConfig config;
+	uint32_t containers_per_zone = 0;
+
+	std::vector<uint64_t> write_pointer;
+	std::vector<uint64_t> zone_appended;  // bytes since the start
+	std::vector<uint32_t> zone_live;  // containers appended, not yet erased
+	std::vector<uint8_t> zone_state;
+	std::vector<uint32_t> zone_resets;
+	std::vector<uint32_t> container_zone;  // NO_ZONE when not on flash
+	std::set<uint32_t> empty_zones;
+	std::vector<uint32_t> stream_zone;  // open zone per stream, or NO_ZONE
+	uint64_t flushes = 0;
+
+	uint32_t active_zones = 0;
+	uint32_t peak_active_zones = 0;
+	uint64_t early_finishes = 0;
+	uint64_t early_finish_bytes = 0;
+	uint64_t empty_zone_shortfalls = 0;
+	uint64_t resets = 0;
+	uint64_t reset_fill_hist[NUM_BUCKETS] = {};
+
+	uint64_t last_resets = 0;
+	std::vector<size_t> segment_resets;
+	std::vector<size_t> segment_active_zones;
+
+	ZnsStats() {}
+
+	ZnsStats(ZnsConfig c)
+		: config(c) {
+		if (!config.zone_bytes || !config.container_bytes || 
+				config.container_bytes > config.zone_bytes) {
+			throw std::invalid_argument("ZNS mode needs containers no larger "
+					"than a zone");
+		}
+		if (!config.open_zones) {
+			throw std::invalid_argument("ZNS mode needs an open zone");
+		}
+		containers_per_zone = config.zone_bytes/config.container_bytes;
+		stream_zone.assign(config.open_zones, NO_ZONE);
+		resize(config.num_zones);
+	}
+
+	bool enabled() const {
+		return containers_per_zone != 0;
+	}
+
+	void resize(size_t zones) {
+		for (size_t z = zone_state.size(); z < zones; ++z) {
+			empty_zones.insert(z);
+		}
+		write_pointer.resize(zones, 0);
+		zone_appended.resize(zones, 0);
+		zone_live.resize(zones, 0);
+		zone_state.resize(zones, Z_EMPTY);
+		zone_resets.resize(zones, 0);
+	}
+
+	void open_zone(uint32_t stream) {
+		if (config.max_active_zones && 
+				active_zones >= config.max_active_zones) {
+			finish_early();
+		}
+		if (empty_zones.empty()) {
+			if (config.num_zones) {
+				empty_zone_shortfalls++;
+			}
+			resize(zone_state.size() + 1);
+		}
+		uint32_t z = *empty_zones.begin();
+		empty_zones.erase(empty_zones.begin());
+		zone_state[z] = Z_OPEN;
+		stream_zone[stream] = z;
+		active_zones++;
+		peak_active_zones = std::max(peak_active_zones, active_zones);
+	}
+
+	// Make room under max_active_zones by finishing the fullest open zone
+	void finish_early() {
+		uint32_t victim = NO_ZONE;  // a stream
+		for (uint32_t s = 0; s < stream_zone.size(); ++s) {
+			uint32_t z = stream_zone[s];
+			if (z != NO_ZONE && (victim == NO_ZONE || 
+						write_pointer[z] > write_pointer[stream_zone[victim]])) {
+				victim = s;
+			}
+		}
+		if (victim == NO_ZONE) {
+			return;
+		}
+		early_finishes++;
+		early_finish_bytes += config.zone_bytes - 
+			write_pointer[stream_zone[victim]];
+		finish_zone(victim);
+	}
+
+	void finish_zone(uint32_t stream) {
+		uint32_t z = stream_zone[stream];
+		zone_state[z] = Z_FULL;
+		active_zones--;
+		stream_zone[stream] = NO_ZONE;
+		if (!zone_live[z]) {
+			reset(z);
+		}
+	}
+
+	void reset(uint32_t z) {
+		double fill = std::min(1.0, (double)write_pointer[z]/config.zone_bytes);
+		size_t bucket = std::min((size_t)(fill * NUM_BUCKETS), NUM_BUCKETS - 1);
+		reset_fill_hist[bucket]++;
+		resets++;
+		zone_resets[z]++;
+
+		zone_state[z] = Z_EMPTY;
+		write_pointer[z] = 0;
+		empty_zones.insert(z);
+	}
+
+	void on_container_flush(container_t id, size_t unused_capacity) {
+		size_t bytes = config.container_bytes - 
+			std::min(unused_capacity, config.container_bytes);
+		// A container rewritten without an erase drops its old copy
+		on_container_erase(id);
+
+		uint32_t stream = flushes++ % config.open_zones;
+		uint32_t z = stream_zone[stream];
+		if (z != NO_ZONE && write_pointer[z] + bytes > config.zone_bytes) {
+			finish_zone(stream);
+		}
+		if (stream_zone[stream] == NO_ZONE) {
+			open_zone(stream);
+		}
+		z = stream_zone[stream];
+		write_pointer[z] += bytes;
+		zone_appended[z] += bytes;
+		zone_live[z]++;
+		if (id >= container_zone.size()) {
+			container_zone.resize(id + 1, NO_ZONE);
+		}
+		container_zone[id] = z;
+	}
+
+	void on_container_erase(container_t id) {
+		if (id >= container_zone.size() || container_zone[id] == NO_ZONE) {
+			return;
+		}
+		uint32_t z = container_zone[id];
+		container_zone[id] = NO_ZONE;
+		// An open zone is reset once it has been finished
+		if (!--zone_live[z] && zone_state[z] != Z_OPEN) {
+			reset(z);
+		}
+	}
+
+	void collect_periodic_stats() {
+		segment_resets.push_back(resets - last_resets);
+		last_resets = resets;
+		segment_active_zones.push_back(active_zones);
+	}
+
+	// elapsed: trace seconds, for the reset rate
+	std::string to_json(std::string name, double elapsed) {
+		std::string str = "\"" + name + "\": {\n";
+		str += "\"zone_bytes\": " + std::to_string(config.zone_bytes) + ",\n";
+		str += "\"containers_per_zone\": " + 
+			std::to_string(containers_per_zone) + ",\n";
+		str += "\"zones\": " + std::to_string(zone_state.size()) + ",\n";
+		str += "\"active_zones\": " + std::to_string(active_zones) + ",\n";
+		str += "\"peak_active_zones\": " + std::to_string(peak_active_zones) + 
+			",\n";
+		str += "\"open_zones\": " + std::to_string(config.open_zones) + ",\n";
+		str += "\"max_active_zones\": " + 
+			std::to_string(config.max_active_zones) + ",\n";
+		str += "\"early_finishes\": " + std::to_string(early_finishes) + ",\n";
+		str += "\"early_finish_bytes\": " + 
+			std::to_string(early_finish_bytes) + ",\n";
+		str += "\"empty_zone_shortfalls\": " + 
+			std::to_string(empty_zone_shortfalls) + ",\n";
+		str += "\"resets\": " + std::to_string(resets) + ",\n";
+		str += "\"resets_per_sec\": " + 
+			std::to_string(elapsed > 0 ? resets/elapsed : 0) + ",\n";
+
+		str += "\"reset_fill_hist\": [";
+		for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+			str += std::to_string(reset_fill_hist[i]);
+			str += (i + 1 < NUM_BUCKETS) ? ", " : "],\n";
+		}
+
+		std::vector<size_t> wp(write_pointer.begin(), write_pointer.end());
+		std::vector<size_t> appended(zone_appended.begin(), zone_appended.end());
+		std::vector<size_t> zresets(zone_resets.begin(), zone_resets.end());
+		str += print_segment_data(wp, "write_pointers") + ",\n";
+		str += print_segment_data(appended, "zone_bytes_appended") + ",\n";
+		str += print_segment_data(zresets, "zone_resets") + ",\n";
+		str += print_segment_data(segment_resets, "segment_resets") + ",\n";
+		str += print_segment_data(segment_active_zones, 
+				"segment_active_zones") + "\n";
+		str += "}";
+		return str;
+	}
+};
+
+#endif  // ZNS_STATS_H